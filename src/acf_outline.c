@@ -19,10 +19,10 @@
 #include <stdio.h>
 
 #include <acfutils/assert.h>
-#include <acfutils/acf_file.h>
 #include <acfutils/perf.h>
 
 #include "acf_outline.h"
+#include "acf_props.h"
 
 #define	READ_PROP(x, func, ...) \
 	do { \
@@ -30,7 +30,7 @@
 		const char *str; \
 		VERIFY3S(snprintf(path, sizeof (path), __VA_ARGS__), <=, \
 		    sizeof (path)); \
-		str = acf_prop_find(acf, path); \
+		str = acf_props_find(acf, path); \
 		if (str == NULL) { \
 			logMsg("Error parsing acf file: property %s not found",\
 			    path); \
@@ -61,7 +61,7 @@ typedef enum {
  * B_TRUE if successful, B_FALSE otherwise.
  */
 bool_t
-part_outline_read(const acf_file_t *acf, int part_nbr, vect2_t *pts, int s_dim,
+part_outline_read(const acf_props_t *acf, int part_nbr, vect2_t *pts, int s_dim,
     float z_ref)
 {
 	int r_dim;
@@ -103,7 +103,7 @@ errout:
  * the respective 2 edge points are stored (in the same order as above).
  */
 bool_t
-wing_seg_outline_read(const acf_file_t *acf, int wing_nbr, vect2_t pts[4],
+wing_seg_outline_read(const acf_props_t *acf, int wing_nbr, vect2_t pts[4],
     vect2_t *tip_p, double z_ref, wing_outline_type_t type)
 {
 	vect2_t root, tip;
@@ -148,7 +148,7 @@ errout:
  * stored in there.
  */
 int
-wing_outline_read(const acf_file_t *acf, int n_wing_nbrs,
+wing_outline_read(const acf_props_t *acf, int n_wing_nbrs,
     const int *wing_nbrs, vect2_t *pts, vect2_t *tip_p, double z_ref)
 {
 	int p = 0;
@@ -184,7 +184,7 @@ wing_outline_read(const acf_file_t *acf, int n_wing_nbrs,
  * of wing segments left in wing_nbrs (0 if none are used in the model).
  */
 static int
-count_wings(const acf_file_t *acf, int *wing_nbrs, int n_wing_nbrs)
+count_wings(const acf_props_t *acf, int *wing_nbrs, int n_wing_nbrs)
 {
 	double prev_x_arm = 0;
 
@@ -214,10 +214,9 @@ errout:
 }
 
 acf_outline_t *
-acf_outline_read(const char *filename)
+acf_outline_read(const acf_props_t *acf)
 {
 	acf_outline_t *outline = NULL;
-	acf_file_t *acf = acf_file_read(filename);
 	vect2_t *pts = NULL;
 	int p, s_dim_fus;
 	double z_ref;
@@ -230,9 +229,6 @@ acf_outline_read(const char *filename)
 	int stab_wings[N_STAB_WINGS] = { 17 };
 	int n_stab_wings;
 
-	if (acf == NULL)
-		goto errout;
-
 	outline = calloc(1, sizeof (*outline));
 
 	READ_INT(s_dim_fus, "_part/56/_s_dim");
@@ -254,7 +250,7 @@ acf_outline_read(const char *filename)
 	p += wing_outline_read(acf, n_stab_wings, stab_wings,
 	    &outline->pts[p], &outline->wingtip, z_ref);
 
-	if (acf_prop_find(acf, "acf/_size_x") == NULL) {
+	if (acf_props_find(acf, "acf/_size_x") == NULL) {
 		double x_dim[2] = {1e10, 0};
 		double y_dim[2] = {1e10, 0};
 
@@ -281,15 +277,11 @@ acf_outline_read(const char *filename)
 		READ_FEET(outline->length, 0, "acf/_size_z");
 	}
 
-	acf_file_free(acf);
-
 	return (outline);
 
 errout:
 	if (outline != NULL)
 		acf_outline_free(outline);
-	if (acf != NULL)
-		acf_file_free(acf);
 	return (NULL);
 }
 
@@ -21,6 +21,8 @@
 
 #include <acfutils/geom.h>
 
+#include "acf_props.h"
+
 #ifdef	__cplusplus
 extern "C" {
 #endif
@@ -33,7 +35,7 @@ typedef struct {
 	size_t	num_pts;	/* number of elements in `pts' */
 } acf_outline_t;
 
-acf_outline_t *acf_outline_read(const char *filename);
+acf_outline_t *acf_outline_read(const acf_props_t *acf);
 void acf_outline_free(acf_outline_t *outline);
 
 #ifdef	__cplusplus
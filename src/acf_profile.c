@@ -0,0 +1,284 @@
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+*/
+/*
+ * Copyright 2020 Saso Kiselkov. All rights reserved.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <acfutils/assert.h>
+#include <acfutils/crc64.h>
+#include <acfutils/helpers.h>
+#include <acfutils/log.h>
+
+#include "acf_profile.h"
+#include "xplane.h"
+
+#define	PROFILE_DIRS		bp_xpdir, "Output", "caches", \
+	"BetterPushback_acf"
+#define	PROFILE_VERSION		2
+#define	MAX_OUTLINE_PTS		100000
+
+/*
+ * The profile cache file format is a simple line-oriented text file:
+ *
+ * version <PROFILE_VERSION>
+ * acf_size <size of .acf file in bytes>
+ * acf_mtime <modification time of .acf file in seconds since epoch>
+ * acf_path <full path to .acf file, to the end of the line>
+ * flags <is_airliner> <is_experimental> ... <fly_like_a_helo>
+ * outline <semispan> <length> <wingtip.x> <wingtip.y> <num_pts>
+ * pt <x> <y>		(repeated, one line for each outline point)
+ * sep			(stands in for a NULL_VECT2 outline separator)
+ * end
+ *
+ * The file name is the CRC64 of the .acf path. Since the path is also
+ * stored in the file, CRC collisions are detected and treated as misses.
+ */
+
+static char *
+profile_path(const char *acf_path)
+{
+	char filename[32];
+
+	snprintf(filename, sizeof (filename), "%016" PRIx64 ".dat",
+	    crc64(acf_path, strlen(acf_path)));
+	return (mkpathname(PROFILE_DIRS, filename, NULL));
+}
+
+static bool_t
+acf_stat(const char *acf_path, uint64_t *size, int64_t *mtime)
+{
+	struct stat st;
+
+	if (stat(acf_path, &st) < 0) {
+		logMsg("Cannot stat %s: %s", acf_path, strerror(errno));
+		return (B_FALSE);
+	}
+	*size = st.st_size;
+	*mtime = st.st_mtime;
+
+	return (B_TRUE);
+}
+
+void
+acf_profile_free(acf_profile_t *prof)
+{
+	if (prof->outline != NULL)
+		acf_outline_free(prof->outline);
+	free(prof);
+}
+
+/*
+ * Attempts to load a cached aircraft profile for the .acf file at
+ * `acf_path'. Returns NULL if no cached profile exists, or if the cached
+ * profile is stale (the .acf file has changed since it was stored). If
+ * `want_outline' is B_FALSE, the outline points are skipped and the
+ * returned profile's outline is NULL.
+ */
+acf_profile_t *
+acf_profile_load(const char *acf_path, bool_t want_outline)
+{
+	char *filename = profile_path(acf_path);
+	FILE *fp = fopen(filename, "r");
+	acf_profile_t *prof = NULL;
+	char *line = NULL;
+	size_t cap = 0, pt_i = 0;
+	uint64_t size, cached_size = 0;
+	int64_t mtime, cached_mtime = 0;
+	int version = 0;
+	bool_t path_ok = B_FALSE, complete = B_FALSE;
+
+	if (fp == NULL)
+		goto errout;
+	if (!acf_stat(acf_path, &size, &mtime))
+		goto errout;
+
+	prof = calloc(1, sizeof (*prof));
+
+	while (getline(&line, &cap, fp) > 0) {
+		char word[32];
+		acf_t *acf = &prof->acf;
+
+		strip_space(line);
+		if (*line == '#' || *line == 0)
+			continue;
+		if (sscanf(line, "%31s", word) != 1)
+			continue;
+
+		if (strcmp(word, "version") == 0) {
+			if (sscanf(line, "version %d", &version) != 1 ||
+			    version != PROFILE_VERSION)
+				goto errout;
+		} else if (strcmp(word, "acf_size") == 0) {
+			if (sscanf(line, "acf_size %" SCNu64,
+			    &cached_size) != 1 || cached_size != size)
+				goto errout;
+		} else if (strcmp(word, "acf_mtime") == 0) {
+			if (sscanf(line, "acf_mtime %" SCNd64,
+			    &cached_mtime) != 1 || cached_mtime != mtime)
+				goto errout;
+		} else if (strcmp(word, "acf_path") == 0) {
+			if (strcmp(line + strlen("acf_path "), acf_path) != 0)
+				goto errout;
+			path_ok = B_TRUE;
+		} else if (strcmp(word, "flags") == 0) {
+			if (sscanf(line, "flags %d %d %d %d %d %d %d %d %d "
+			    "%d %d", &acf->model_flags.is_airliner,
+			    &acf->model_flags.is_experimental,
+			    &acf->model_flags.is_general_aviation,
+			    &acf->model_flags.is_glider,
+			    &acf->model_flags.is_helicopter,
+			    &acf->model_flags.is_military,
+			    &acf->model_flags.is_sci_fi,
+			    &acf->model_flags.is_seaplane,
+			    &acf->model_flags.is_ultralight,
+			    &acf->model_flags.is_vtol,
+			    &acf->model_flags.fly_like_a_helo) != 11)
+				goto errout;
+		} else if (strcmp(word, "outline") == 0) {
+			acf_outline_t *outline;
+
+			if (!want_outline)
+				continue;
+			if (prof->outline != NULL)
+				goto errout;
+			outline = calloc(1, sizeof (*outline));
+			prof->outline = outline;
+			if (sscanf(line, "outline %lf %lf %lf %lf %zu",
+			    &outline->semispan, &outline->length,
+			    &outline->wingtip.x, &outline->wingtip.y,
+			    &outline->num_pts) != 5 || outline->num_pts == 0 ||
+			    outline->num_pts > MAX_OUTLINE_PTS)
+				goto errout;
+			outline->pts = calloc(outline->num_pts,
+			    sizeof (*outline->pts));
+		} else if (strcmp(word, "pt") == 0 ||
+		    strcmp(word, "sep") == 0) {
+			acf_outline_t *outline = prof->outline;
+
+			if (!want_outline)
+				continue;
+			if (outline == NULL || pt_i >= outline->num_pts)
+				goto errout;
+			if (strcmp(word, "sep") == 0) {
+				outline->pts[pt_i] = NULL_VECT2;
+			} else if (sscanf(line, "pt %lf %lf",
+			    &outline->pts[pt_i].x,
+			    &outline->pts[pt_i].y) != 2) {
+				goto errout;
+			}
+			pt_i++;
+		} else if (strcmp(word, "end") == 0) {
+			complete = B_TRUE;
+			break;
+		} else {
+			goto errout;
+		}
+	}
+
+	if (!complete || version != PROFILE_VERSION || !path_ok ||
+	    (want_outline && (prof->outline == NULL ||
+	    pt_i != prof->outline->num_pts)))
+		goto errout;
+
+	free(line);
+	fclose(fp);
+	free(filename);
+
+	return (prof);
+errout:
+	if (prof != NULL)
+		acf_profile_free(prof);
+	free(line);
+	if (fp != NULL)
+		fclose(fp);
+	free(filename);
+
+	return (NULL);
+}
+
+/*
+ * Stores an aircraft profile for the .acf file at `acf_path' into the
+ * profile cache, replacing any previously cached profile for this file.
+ */
+bool_t
+acf_profile_store(const char *acf_path, const acf_t *acf,
+    const acf_outline_t *outline)
+{
+	char *dirname = mkpathname(PROFILE_DIRS, NULL);
+	char *filename = NULL;
+	FILE *fp = NULL;
+	uint64_t size;
+	int64_t mtime;
+	bool_t res = B_FALSE;
+
+	ASSERT(acf != NULL);
+	ASSERT(outline != NULL);
+
+	if (!acf_stat(acf_path, &size, &mtime))
+		goto out;
+	if (!file_exists(dirname, NULL) &&
+	    !create_directory_recursive(dirname))
+		goto out;
+
+	filename = profile_path(acf_path);
+	fp = fopen(filename, "w");
+	if (fp == NULL) {
+		logMsg("Error writing file %s: %s", filename, strerror(errno));
+		goto out;
+	}
+
+	fprintf(fp, "### This is a BetterPushback aircraft profile ###\n"
+	    "### This file is automatically generated. DO NOT EDIT! ###\n");
+	fprintf(fp, "version %d\n", PROFILE_VERSION);
+	fprintf(fp, "acf_size %" PRIu64 "\n", size);
+	fprintf(fp, "acf_mtime %" PRId64 "\n", mtime);
+	fprintf(fp, "acf_path %s\n", acf_path);
+	fprintf(fp, "flags %d %d %d %d %d %d %d %d %d %d %d\n",
+	    acf->model_flags.is_airliner, acf->model_flags.is_experimental,
+	    acf->model_flags.is_general_aviation, acf->model_flags.is_glider,
+	    acf->model_flags.is_helicopter, acf->model_flags.is_military,
+	    acf->model_flags.is_sci_fi, acf->model_flags.is_seaplane,
+	    acf->model_flags.is_ultralight, acf->model_flags.is_vtol,
+	    acf->model_flags.fly_like_a_helo);
+	fprintf(fp, "outline %.17g %.17g %.17g %.17g %zu\n", outline->semispan,
+	    outline->length, outline->wingtip.x, outline->wingtip.y,
+	    outline->num_pts);
+	for (size_t i = 0; i < outline->num_pts; i++) {
+		if (IS_NULL_VECT(outline->pts[i])) {
+			fprintf(fp, "sep\n");
+		} else {
+			fprintf(fp, "pt %.17g %.17g\n", outline->pts[i].x,
+			    outline->pts[i].y);
+		}
+	}
+	fprintf(fp, "end\n");
+
+	res = (ferror(fp) == 0);
+out:
+	if (fp != NULL)
+		fclose(fp);
+	if (!res && filename != NULL)
+		(void) remove_file(filename, B_FALSE);
+	free(filename);
+	free(dirname);
+
+	return (res);
+}
@@ -0,0 +1,54 @@
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+*/
+/*
+ * Copyright 2020 Saso Kiselkov. All rights reserved.
+ */
+
+#ifndef	_ACF_PROFILE_H_
+#define	_ACF_PROFILE_H_
+
+#include <acfutils/types.h>
+
+#include "acf_outline.h"
+#include "bp.h"
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/*
+ * An aircraft profile is everything we extract from an aircraft's .acf
+ * file. Profiles are cached on disk in Output/caches/BetterPushback_acf,
+ * keyed by the .acf file's path, size and modification time, so that we
+ * don't need to reparse the .acf file every time pushback is started.
+ * Anything we read from datarefs (such as the gear info) isn't part of
+ * the profile, as that can change with the aircraft's state, or be
+ * overridden by the aircraft's plugins.
+ */
+typedef struct {
+	acf_t		acf;		/* only the model flags are filled in */
+	acf_outline_t	*outline;	/* can be NULL if not requested */
+} acf_profile_t;
+
+acf_profile_t *acf_profile_load(const char *acf_path, bool_t want_outline);
+bool_t acf_profile_store(const char *acf_path, const acf_t *acf,
+    const acf_outline_t *outline);
+void acf_profile_free(acf_profile_t *prof);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _ACF_PROFILE_H_ */
@@ -0,0 +1,290 @@
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+*/
+/*
+ * Copyright 2020 Saso Kiselkov. All rights reserved.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if	!IBM
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <acfutils/assert.h>
+#include <acfutils/helpers.h>
+#include <acfutils/log.h>
+
+#include "acf_props.h"
+
+#define	MIN_BUCKETS	1024
+
+/*
+ * All property names & values are packed back-to-back as NUL-terminated
+ * strings into a single string pool ("name\0value\0name\0value\0...").
+ * The hash table is a simple open-addressing table of offsets into that
+ * pool. An offset of UINT32_MAX marks an empty bucket.
+ */
+typedef struct {
+	uint32_t	hash;
+	uint32_t	name_off;
+	uint32_t	value_off;
+} prop_t;
+
+struct acf_props {
+	char		*pool;
+	size_t		pool_len;
+	size_t		pool_cap;
+	prop_t		*buckets;
+	size_t		n_buckets;	/* always a power of 2 */
+	size_t		n_props;
+};
+
+/* FNV-1a */
+static uint32_t
+prop_hash(const char *name, size_t len)
+{
+	uint32_t h = 2166136261u;
+
+	for (size_t i = 0; i < len; i++) {
+		h ^= (uint8_t)name[i];
+		h *= 16777619u;
+	}
+	return (h);
+}
+
+static uint32_t
+pool_append(acf_props_t *props, const char *str, size_t len)
+{
+	uint32_t off = props->pool_len;
+
+	if (props->pool_len + len + 1 > props->pool_cap) {
+		props->pool_cap = MAX(props->pool_cap * 2,
+		    props->pool_len + len + 1);
+		props->pool = realloc(props->pool, props->pool_cap);
+	}
+	memcpy(&props->pool[props->pool_len], str, len);
+	props->pool[props->pool_len + len] = 0;
+	props->pool_len += len + 1;
+
+	return (off);
+}
+
+static void
+props_grow(acf_props_t *props)
+{
+	prop_t *old = props->buckets;
+	size_t old_n = props->n_buckets;
+
+	props->n_buckets = (old_n == 0 ? MIN_BUCKETS : old_n * 2);
+	props->buckets = malloc(props->n_buckets * sizeof (*props->buckets));
+	for (size_t i = 0; i < props->n_buckets; i++)
+		props->buckets[i].name_off = UINT32_MAX;
+
+	for (size_t i = 0; i < old_n; i++) {
+		size_t j;
+
+		if (old[i].name_off == UINT32_MAX)
+			continue;
+		for (j = old[i].hash & (props->n_buckets - 1);
+		    props->buckets[j].name_off != UINT32_MAX;
+		    j = (j + 1) & (props->n_buckets - 1))
+			;
+		props->buckets[j] = old[i];
+	}
+	free(old);
+}
+
+/*
+ * Returns the bucket for property `name' (of length `len'). If the
+ * property isn't in the table, returns the empty bucket where it would
+ * go.
+ */
+static prop_t *
+props_lookup(const acf_props_t *props, const char *name, size_t len,
+    uint32_t hash)
+{
+	for (size_t i = hash & (props->n_buckets - 1);;
+	    i = (i + 1) & (props->n_buckets - 1)) {
+		prop_t *prop = &props->buckets[i];
+
+		if (prop->name_off == UINT32_MAX)
+			return (prop);
+		if (prop->hash == hash &&
+		    strncmp(&props->pool[prop->name_off], name, len) == 0 &&
+		    props->pool[prop->name_off + len] == 0)
+			return (prop);
+	}
+}
+
+static void
+props_add(acf_props_t *props, const char *name, size_t name_len,
+    const char *value, size_t value_len)
+{
+	uint32_t hash = prop_hash(name, name_len);
+	prop_t *prop;
+
+	/* keep the load factor under 1/2 */
+	if ((props->n_props + 1) * 2 > props->n_buckets)
+		props_grow(props);
+
+	prop = props_lookup(props, name, name_len, hash);
+	if (prop->name_off == UINT32_MAX) {
+		prop->hash = hash;
+		prop->name_off = pool_append(props, name, name_len);
+		props->n_props++;
+	}
+	/* later definitions override earlier ones */
+	prop->value_off = pool_append(props, value, value_len);
+}
+
+/*
+ * Walks the buffer line by line and picks out all the property lines
+ * ("P <name> <value>").
+ */
+static void
+props_parse(acf_props_t *props, const char *buf, size_t len)
+{
+	const char *end = buf + len;
+
+	for (const char *line = buf; line < end;) {
+		const char *eol = memchr(line, '\n', end - line);
+		const char *name, *name_end, *value;
+
+		if (eol == NULL)
+			eol = end;
+		/* strip trailing whitespace & CR */
+		name_end = eol;
+		while (name_end > line && (name_end[-1] == '\r' ||
+		    name_end[-1] == ' ' || name_end[-1] == '\t'))
+			name_end--;
+
+		if (name_end - line > 2 && line[0] == 'P' && line[1] == ' ') {
+			const char *line_end = name_end;
+
+			name = line + 2;
+			for (name_end = name; name_end < line_end &&
+			    *name_end != ' ' && *name_end != '\t'; name_end++)
+				;
+			for (value = name_end; value < line_end &&
+			    (*value == ' ' || *value == '\t'); value++)
+				;
+			if (name_end > name) {
+				props_add(props, name, name_end - name, value,
+				    line_end - value);
+			}
+		}
+		line = eol + 1;
+	}
+}
+
+acf_props_t *
+acf_props_read(const char *filename)
+{
+	acf_props_t *props = NULL;
+#if	IBM
+	FILE *fp = fopen(filename, "rb");
+	char *buf = NULL;
+	long len;
+
+	if (fp == NULL || fseek(fp, 0, SEEK_END) < 0 ||
+	    (len = ftell(fp)) < 0 || fseek(fp, 0, SEEK_SET) < 0) {
+		logMsg("Error reading %s: %s", filename, strerror(errno));
+		goto out;
+	}
+	buf = malloc(len + 1);
+	if (fread(buf, 1, len, fp) != (size_t)len) {
+		logMsg("Error reading %s: %s", filename, strerror(errno));
+		goto out;
+	}
+#else	/* !IBM */
+	int fd = open(filename, O_RDONLY);
+	struct stat st;
+	void *buf = MAP_FAILED;
+	size_t len = 0;
+
+	if (fd < 0 || fstat(fd, &st) < 0) {
+		logMsg("Error reading %s: %s", filename, strerror(errno));
+		goto out;
+	}
+	len = st.st_size;
+	if (len != 0) {
+		buf = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (buf == MAP_FAILED) {
+			logMsg("Error mapping %s: %s", filename,
+			    strerror(errno));
+			goto out;
+		}
+		(void) madvise(buf, len, MADV_SEQUENTIAL);
+	}
+#endif	/* !IBM */
+
+	if (len >= UINT32_MAX) {
+		logMsg("Error reading %s: file too large", filename);
+		goto out;
+	}
+
+	props = calloc(1, sizeof (*props));
+	props_grow(props);
+	/* properties take up the bulk of the file, so size the pool to it */
+	props->pool_cap = MAX(len, 1);
+	props->pool = malloc(props->pool_cap);
+	if (len != 0)
+		props_parse(props, buf, len);
+
+out:
+#if	IBM
+	free(buf);
+	if (fp != NULL)
+		fclose(fp);
+#else	/* !IBM */
+	if (buf != MAP_FAILED)
+		munmap(buf, len);
+	if (fd >= 0)
+		close(fd);
+#endif	/* !IBM */
+
+	return (props);
+}
+
+/*
+ * Looks up a property by name. Returns the property's value string, or
+ * NULL if the property isn't defined in the file.
+ */
+const char *
+acf_props_find(const acf_props_t *props, const char *name)
+{
+	size_t len = strlen(name);
+	const prop_t *prop = props_lookup(props, name, len,
+	    prop_hash(name, len));
+
+	if (prop->name_off == UINT32_MAX)
+		return (NULL);
+	return (&props->pool[prop->value_off]);
+}
+
+void
+acf_props_free(acf_props_t *props)
+{
+	free(props->pool);
+	free(props->buckets);
+	free(props);
+}
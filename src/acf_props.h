@@ -0,0 +1,43 @@
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+*/
+/*
+ * Copyright 2020 Saso Kiselkov. All rights reserved.
+ */
+
+#ifndef	_ACF_PROPS_H_
+#define	_ACF_PROPS_H_
+
+#include <stddef.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/*
+ * A read-only table of all the "P <name> <value>" properties in an .acf
+ * file. The file is parsed in a single pass and then released, so the
+ * table doesn't keep the (multi-megabyte) file contents around.
+ */
+typedef struct acf_props acf_props_t;
+
+acf_props_t *acf_props_read(const char *filename);
+const char *acf_props_find(const acf_props_t *props, const char *name);
+void acf_props_free(acf_props_t *props);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _ACF_PROPS_H_ */
@@ -0,0 +1,402 @@
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+*/
+/*
+ * Copyright 2020 Saso Kiselkov. All rights reserved.
+ */
+
+
+/*
+ * Airport surface overlay for the pushback planner. Shows the runways and
+ * ramp starts of the nearest airport, so the user has something other
+ * than the scenery to place segments against.
+ *
+ * The layout is extracted from the airport database by the airport
+ * service's worker thread (see arpt_svc_request_surf). Once it arrives,
+ * it's tessellated into line primitives in local coordinates, which are
+ * binned into a grid of GRID_CELL_SZ cells and uploaded into a single
+ * vertex buffer, sorted by cell. A large hub has thousands of vertices
+ * and each of them needs a terrain height, so rather than stalling a
+ * single frame on all of those probes, the heights are filled in a
+ * few hundred at a time over the following frames and the overlay
+ * only shows up once they're all in. Long runway edges are split up so that
+ * no primitive spans more than a cell. When drawing, only cells whose
+ * bounding box intersects the visible area get drawn, so even large hubs
+ * cost just a handful of draw calls. The overlay is kept for as long as
+ * we stay at the same airport and scenery isn't reloaded.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <XPLMGraphics.h>
+
+#include <acfutils/assert.h>
+#include <acfutils/geom.h>
+#include <acfutils/glew.h>
+#include <acfutils/helpers.h>
+#include <acfutils/math.h>
+
+#include "arpt_overlay.h"
+#include "arpt_svc.h"
+#include "terr_cache.h"
+
+#define	GRID_CELL_SZ		500	/* meters */
+#define	MAX_PRIM_LEN		GRID_CELL_SZ	/* meters */
+#define	CTR_DASH_LEN		30	/* meters */
+#define	CTR_DASH_GAP		20	/* meters */
+#define	RAMP_SYM_LEN		8	/* meters */
+#define	RWY_COLOR		VECT3(0.8, 0.8, 0.8)	/* RGB color */
+#define	RAMP_COLOR		VECT3(1, 0.75, 0)	/* RGB color */
+#define	VTX_FLOATS		6	/* x, y, z, r, g, b */
+#define	MAX_HEIGHTS_PER_FRAME	256	/* vertices */
+
+/* A run of GL_LINES vertices, all placed in the same grid cell */
+typedef struct {
+	int32_t		cx, cy;		/* grid cell indices */
+	GLfloat		v[2 * VTX_FLOATS];
+	unsigned	n;		/* vertices in `v' */
+} prim_t;
+
+typedef struct {
+	unsigned	first, n;	/* range of vertices in the VBO */
+	vect2_t		min, max;	/* bounding box, local coords */
+} cell_t;
+
+typedef struct {
+	prim_t		*prims;
+	size_t		n, cap;
+} prim_buf_t;
+
+static struct {
+	char		icao[8];	/* airport being shown or loaded */
+	bool_t		pending;	/* surface requested, not built yet */
+	unsigned	terr_gen;	/* terr_cache_gen at build time */
+	prim_buf_t	build;		/* primitives awaiting heights */
+	size_t		build_next;	/* next vertex needing a height */
+	GLuint		vbo;
+	cell_t		*cells;
+	size_t		n_cells;
+} ov;
+
+static vect2_t
+geo2local(geo_pos2_t pos)
+{
+	double x, y, z;
+
+	XPLMWorldToLocal(pos.lat, pos.lon, 0, &x, &y, &z);
+	/* X-Plane's Z axis is flipped to ours */
+	return (VECT2(x, -z));
+}
+
+/*
+ * Adds a line from `a' to `b' to a new primitive. The primitive is binned
+ * by its midpoint, so lines must not be longer than MAX_PRIM_LEN. The
+ * vertex heights are left for overlay_heights to fill in.
+ */
+static void
+prim_line(prim_buf_t *buf, vect2_t a, vect2_t b, vect3_t color)
+{
+	vect2_t mid = vect2_mean(a, b);
+	vect2_t pts[2] = { a, b };
+	prim_t *prim;
+
+	if (buf->n == buf->cap) {
+		buf->cap = MAX(buf->cap * 2, 64);
+		buf->prims = realloc(buf->prims, buf->cap *
+		    sizeof (*buf->prims));
+	}
+	prim = &buf->prims[buf->n++];
+	prim->cx = floor(mid.x / GRID_CELL_SZ);
+	prim->cy = floor(mid.y / GRID_CELL_SZ);
+	prim->n = 0;
+	for (int i = 0; i < 2; i++) {
+		GLfloat *v = &prim->v[prim->n * VTX_FLOATS];
+
+		v[0] = pts[i].x;
+		v[1] = 0;
+		v[2] = -pts[i].y;
+		v[3] = color.x;
+		v[4] = color.y;
+		v[5] = color.z;
+		prim->n++;
+	}
+}
+
+/* Adds a line of arbitrary length, split up into MAX_PRIM_LEN pieces */
+static void
+prim_long_line(prim_buf_t *buf, vect2_t a, vect2_t b, vect3_t color)
+{
+	double len = vect2_dist(a, b);
+	int n = MAX(ceil(len / MAX_PRIM_LEN), 1);
+	vect2_t step = vect2_scmul(vect2_sub(b, a), 1.0 / n);
+
+	for (int i = 0; i < n; i++) {
+		prim_line(buf, vect2_add(a, vect2_scmul(step, i)),
+		    vect2_add(a, vect2_scmul(step, i + 1)), color);
+	}
+}
+
+static void
+tess_rwy(prim_buf_t *buf, const arpt_rwy_t *rwy)
+{
+	vect2_t p1 = geo2local(rwy->thr[0]);
+	vect2_t p2 = geo2local(rwy->thr[1]);
+	vect2_t dir, norm;
+	double len = vect2_dist(p1, p2);
+
+	if (len < 1)
+		return;
+	dir = vect2_set_abs(vect2_sub(p2, p1), 1);
+	norm = vect2_scmul(vect2_norm(dir, B_TRUE), rwy->width / 2);
+
+	/* edges & threshold bars */
+	prim_long_line(buf, vect2_add(p1, norm), vect2_add(p2, norm),
+	    RWY_COLOR);
+	prim_long_line(buf, vect2_sub(p1, norm), vect2_sub(p2, norm),
+	    RWY_COLOR);
+	prim_line(buf, vect2_add(p1, norm), vect2_sub(p1, norm), RWY_COLOR);
+	prim_line(buf, vect2_add(p2, norm), vect2_sub(p2, norm), RWY_COLOR);
+	/* dashed centerline */
+	for (double d = 0; d + CTR_DASH_LEN <= len;
+	    d += CTR_DASH_LEN + CTR_DASH_GAP) {
+		prim_line(buf, vect2_add(p1, vect2_scmul(dir, d)),
+		    vect2_add(p1, vect2_scmul(dir, d + CTR_DASH_LEN)),
+		    RWY_COLOR);
+	}
+}
+
+/* A chevron pointing in the direction a parked aircraft faces */
+static void
+tess_ramp(prim_buf_t *buf, const arpt_ramp_t *ramp)
+{
+	vect2_t p = geo2local(ramp->pos);
+	vect2_t dir = hdg2dir(ramp->hdg);
+	vect2_t nose = vect2_add(p, vect2_scmul(dir, RAMP_SYM_LEN / 2));
+	vect2_t tail = vect2_sub(p, vect2_scmul(dir, RAMP_SYM_LEN / 2));
+	vect2_t side = vect2_scmul(vect2_norm(dir, B_TRUE), RAMP_SYM_LEN / 2);
+
+	prim_line(buf, vect2_add(tail, side), nose, RAMP_COLOR);
+	prim_line(buf, nose, vect2_sub(tail, side), RAMP_COLOR);
+	prim_line(buf, p, tail, RAMP_COLOR);
+}
+
+static int
+prim_compar(const void *a, const void *b)
+{
+	const prim_t *pa = a, *pb = b;
+
+	if (pa->cx < pb->cx)
+		return (-1);
+	if (pa->cx > pb->cx)
+		return (1);
+	if (pa->cy < pb->cy)
+		return (-1);
+	if (pa->cy > pb->cy)
+		return (1);
+	return (0);
+}
+
+static void
+overlay_free(void)
+{
+	free(ov.build.prims);
+	memset(&ov.build, 0, sizeof (ov.build));
+	ov.build_next = 0;
+	if (ov.vbo != 0)
+		glDeleteBuffers(1, &ov.vbo);
+	ov.vbo = 0;
+	free(ov.cells);
+	ov.cells = NULL;
+	ov.n_cells = 0;
+}
+
+static void
+overlay_tess(const arpt_surf_t *surf)
+{
+	overlay_free();
+
+	for (size_t i = 0; i < surf->n_rwys; i++)
+		tess_rwy(&ov.build, &surf->rwys[i]);
+	for (size_t i = 0; i < surf->n_ramps; i++)
+		tess_ramp(&ov.build, &surf->ramps[i]);
+	ov.terr_gen = terr_cache_gen();
+}
+
+/*
+ * Looks up the terrain heights of up to MAX_HEIGHTS_PER_FRAME more
+ * vertices of the primitives being built. Returns B_TRUE once all of
+ * them have their heights.
+ */
+static bool_t
+overlay_heights(void)
+{
+	/* prim_line always emits two vertices per primitive */
+	size_t n_vtx = ov.build.n * 2;
+	size_t end = MIN(ov.build_next + MAX_HEIGHTS_PER_FRAME, n_vtx);
+
+	for (; ov.build_next < end; ov.build_next++) {
+		prim_t *prim = &ov.build.prims[ov.build_next / 2];
+		GLfloat *v = &prim->v[(ov.build_next % 2) * VTX_FLOATS];
+
+		v[1] = terr_cache_height(VECT2(v[0], -v[2]));
+	}
+
+	return (ov.build_next == n_vtx);
+}
+
+static void
+overlay_upload(void)
+{
+	prim_buf_t buf = ov.build;
+	GLfloat *vtx;
+	unsigned n_vtx = 0;
+
+	memset(&ov.build, 0, sizeof (ov.build));
+	ov.build_next = 0;
+	if (buf.n == 0)
+		return;
+
+	qsort(buf.prims, buf.n, sizeof (*buf.prims), prim_compar);
+	for (size_t i = 0; i < buf.n; i++)
+		n_vtx += buf.prims[i].n;
+	vtx = malloc(n_vtx * VTX_FLOATS * sizeof (*vtx));
+	/* no more cells than primitives */
+	ov.cells = calloc(buf.n, sizeof (*ov.cells));
+
+	n_vtx = 0;
+	for (size_t i = 0; i < buf.n; i++) {
+		const prim_t *prim = &buf.prims[i];
+		cell_t *cell;
+
+		if (i == 0 || prim_compar(prim, &buf.prims[i - 1]) != 0) {
+			cell = &ov.cells[ov.n_cells++];
+			cell->first = n_vtx;
+			cell->min = VECT2(INFINITY, INFINITY);
+			cell->max = VECT2(-INFINITY, -INFINITY);
+		} else {
+			cell = &ov.cells[ov.n_cells - 1];
+		}
+		for (unsigned j = 0; j < prim->n; j++) {
+			const GLfloat *v = &prim->v[j * VTX_FLOATS];
+
+			cell->min.x = MIN(cell->min.x, v[0]);
+			cell->min.y = MIN(cell->min.y, -v[2]);
+			cell->max.x = MAX(cell->max.x, v[0]);
+			cell->max.y = MAX(cell->max.y, -v[2]);
+		}
+		memcpy(&vtx[n_vtx * VTX_FLOATS], prim->v,
+		    prim->n * VTX_FLOATS * sizeof (*vtx));
+		n_vtx += prim->n;
+		cell->n += prim->n;
+	}
+
+	glGenBuffers(1, &ov.vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, ov.vbo);
+	glBufferData(GL_ARRAY_BUFFER, n_vtx * VTX_FLOATS * sizeof (*vtx),
+	    vtx, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	free(vtx);
+	free(buf.prims);
+}
+
+/*
+ * Starts showing the surface of airport `icao' (pass an empty string to
+ * show nothing). If the overlay for `icao' is already built, it is kept.
+ * Otherwise the layout is requested from the airport service and the
+ * overlay gets built by arpt_overlay_draw once the layout has arrived.
+ */
+void
+arpt_overlay_load(const char *icao)
+{
+	ASSERT(icao != NULL);
+
+	if (strcmp(ov.icao, icao) == 0 && (ov.pending ||
+	    ov.terr_gen == terr_cache_gen()))
+		return;
+
+	overlay_free();
+	strlcpy(ov.icao, icao, sizeof (ov.icao));
+	ov.pending = (*icao != 0);
+	if (ov.pending)
+		arpt_svc_request_surf(icao);
+}
+
+/*
+ * Draws the cells of the overlay within `radius' meters of `center' (both
+ * in our local coordinates). Uses the current modelview & projection
+ * matrices. Must be called with a GL context current.
+ */
+void
+arpt_overlay_draw(vect2_t center, double radius)
+{
+	if (!ov.pending && *ov.icao != 0 && ov.terr_gen != terr_cache_gen()) {
+		/* scenery was reloaded, our heights are stale */
+		char icao[8];
+
+		strlcpy(icao, ov.icao, sizeof (icao));
+		arpt_overlay_load(icao);
+	}
+	if (ov.pending) {
+		arpt_surf_t *surf = arpt_svc_collect_surf();
+
+		if (surf == NULL)
+			return;
+		/* ignore stale replies to an earlier request */
+		if (strcmp(surf->icao, ov.icao) == 0) {
+			overlay_tess(surf);
+			ov.pending = B_FALSE;
+		}
+		arpt_surf_free(surf);
+	}
+	if (ov.build.prims != NULL) {
+		if (!overlay_heights())
+			return;
+		overlay_upload();
+	}
+	if (ov.vbo == 0)
+		return;
+
+	glBindBuffer(GL_ARRAY_BUFFER, ov.vbo);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	glVertexPointer(3, GL_FLOAT, VTX_FLOATS * sizeof (GLfloat), NULL);
+	glColorPointer(3, GL_FLOAT, VTX_FLOATS * sizeof (GLfloat),
+	    (void *)(3 * sizeof (GLfloat)));
+	glLineWidth(1);
+
+	for (size_t i = 0; i < ov.n_cells; i++) {
+		const cell_t *cell = &ov.cells[i];
+
+		if (cell->max.x < center.x - radius ||
+		    cell->min.x > center.x + radius ||
+		    cell->max.y < center.y - radius ||
+		    cell->min.y > center.y + radius)
+			continue;
+		glDrawArrays(GL_LINES, cell->first, cell->n);
+	}
+
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void
+arpt_overlay_fini(void)
+{
+	overlay_free();
+	memset(&ov, 0, sizeof (ov));
+}
@@ -0,0 +1,37 @@
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+*/
+/*
+ * Copyright 2020 Saso Kiselkov. All rights reserved.
+ */
+
+
+#ifndef	_ARPT_OVERLAY_H_
+#define	_ARPT_OVERLAY_H_
+
+#include <acfutils/geom.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+void arpt_overlay_load(const char *icao);
+void arpt_overlay_draw(vect2_t center, double radius);
+void arpt_overlay_fini(void);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _ARPT_OVERLAY_H_ */
@@ -0,0 +1,655 @@
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+*/
+/*
+ * Copyright 2020 Saso Kiselkov. All rights reserved.
+ */
+
+/*
+ * The airport service keeps the airport tiles around the aircraft loaded
+ * and maintains a small spatial index of the airport reference points in
+ * them, so that "what's the nearest airport" can be answered without
+ * touching the airport database.
+ *
+ * All airportdb_t access happens on the service's worker thread. The
+ * main thread only ever looks at the index, which is a self-contained
+ * copy of the ICAO codes & ECEF positions of the airports. While the
+ * aircraft is on the ground, a flight loop periodically hands the
+ * aircraft's position to the worker, which rebuilds the index in the
+ * background once we've moved far enough from where it was last built.
+ *
+ * The worker also extracts the surface layout (runways & ramp starts) of
+ * an airport on request, for the planner's airport overlay. Again, this
+ * is a self-contained copy, handed over to the main thread once built.
+ *
+ * Before doing any of that, the airport database cache needs to be
+ * (re)built, which after a scenery or nav data update can take quite a
+ * while and can't be interrupted. So that disabling the plugin doesn't
+ * have to sit through that, the build runs on its own thread against a
+ * private airportdb_t. arpt_svc_fini leaves an unfinished build running
+ * and the next arpt_svc_init picks it back up. Only arpt_svc_stop (called
+ * from XPluginStop) waits for it, as no thread of ours may outlive the
+ * plugin.
+ *
+ * Until the cache is ready (and after a reposition, until the worker has
+ * indexed the new area), arpt_svc_find_nearest reports that there's no
+ * airport nearby, rather than blocking. Airport dependent features (tug
+ * livery selection, local voice accents and the planner's airport
+ * overlay) use arpt_svc_ready to wait for a final answer, rather than
+ * fall back to their generic versions.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <XPLMProcessing.h>
+
+#include <acfutils/assert.h>
+#include <acfutils/dr.h>
+#include <acfutils/helpers.h>
+#include <acfutils/log.h>
+#include <acfutils/thread.h>
+#include <acfutils/time.h>
+
+#include "arpt_svc.h"
+
+/*
+ * find_nearest_airports returns airports within 8 NM of the position
+ * passed to it, so that's the radius the index is guaranteed to cover.
+ */
+#define	INDEX_RADIUS	14816		/* meters, 8 NM */
+#define	MAX_QUERY_DIST	10000		/* meters */
+#define	REFRESH_DIST	(INDEX_RADIUS - MAX_QUERY_DIST)	/* meters */
+#define	CELL_SZ		MAX_QUERY_DIST	/* meters */
+#define	CELL_BITS	21
+#define	CELL_MASK	((1 << CELL_BITS) - 1)
+#define	POLL_INTVAL	5		/* seconds */
+#define	WORKER_INTVAL	10		/* seconds */
+#define	BUILD_POLL_INTVAL	1	/* seconds */
+
+typedef struct {
+	char		icao[8];
+	vect3_t		ecef;
+	int64_t		cell;
+} arpt_ent_t;
+
+typedef struct {
+	arpt_ent_t	*ents;		/* sorted by `cell' */
+	size_t		n_ents;
+	vect3_t		center;		/* ECEF, NULL_VECT3 if never built */
+} arpt_idx_t;
+
+static struct {
+	bool_t		inited;
+	airportdb_t	*db;
+	thread_t	worker;
+	mutex_t		lock;
+	condvar_t	worker_cv;	/* wakes up the worker */
+	bool_t		shutdown;
+	bool_t		ready;		/* airport database cache is usable */
+	bool_t		failed;		/* cache build failed */
+	geo_pos2_t	req_pos;	/* latest position of interest */
+	arpt_idx_t	idx;
+	char		surf_icao[8];	/* surface requested, "" if none */
+	arpt_surf_t	*surf;		/* surface built, NULL if none */
+	XPLMFlightLoopID floop;
+} svc;
+
+static struct {
+	dr_t	lat, lon;
+	dr_t	onground_any;
+} drs;
+
+/*
+ * A cache build in progress. It's only ever touched by the main thread
+ * while the worker isn't running and by the worker while it is, except
+ * for `done' & `ok', which the builder thread sets under build_lock.
+ * Both can outlive the service (see arpt_svc_stop).
+ */
+typedef struct {
+	airportdb_t	db;
+	thread_t	thr;
+	bool_t		done;
+	bool_t		ok;
+} cache_build_t;
+
+static bool_t		build_lock_inited = B_FALSE;
+static mutex_t		build_lock;
+static cache_build_t	*build = NULL;
+
+static int64_t
+ecef2cell(vect3_t ecef)
+{
+	int64_t x = (int64_t)floor(ecef.x / CELL_SZ) & CELL_MASK;
+	int64_t y = (int64_t)floor(ecef.y / CELL_SZ) & CELL_MASK;
+	int64_t z = (int64_t)floor(ecef.z / CELL_SZ) & CELL_MASK;
+
+	return ((x << (2 * CELL_BITS)) | (y << CELL_BITS) | z);
+}
+
+static int
+ent_compar(const void *a, const void *b)
+{
+	const arpt_ent_t *ea = a, *eb = b;
+
+	if (ea->cell < eb->cell)
+		return (-1);
+	if (ea->cell > eb->cell)
+		return (1);
+	return (0);
+}
+
+static vect3_t
+pos2ecef(geo_pos2_t pos)
+{
+	return (geo2ecef_mtr(GEO_POS3(pos.lat, pos.lon, 0), &wgs84));
+}
+
+static bool_t
+idx_covers(const arpt_idx_t *idx, vect3_t pos_ecef)
+{
+	return (!IS_NULL_VECT(idx->center) &&
+	    vect3_dist(idx->center, pos_ecef) <= REFRESH_DIST);
+}
+
+static void
+idx_free(arpt_idx_t *idx)
+{
+	free(idx->ents);
+	idx->ents = NULL;
+	idx->n_ents = 0;
+	idx->center = NULL_VECT3;
+}
+
+/*
+ * Loads the airport tiles around `pos' and builds a fresh index from the
+ * airports in them. Tiles far from `pos' are dropped, the ones nearby
+ * stay resident so the next rebuild is cheap. Worker thread only.
+ */
+static void
+idx_build(arpt_idx_t *idx, geo_pos2_t pos)
+{
+	list_t *list;
+	size_t i = 0;
+
+	load_nearest_airport_tiles(svc.db, pos);
+	list = find_nearest_airports(svc.db, pos);
+
+	idx->n_ents = list_count(list);
+	idx->ents = calloc(MAX(idx->n_ents, 1), sizeof (*idx->ents));
+	for (airport_t *arpt = list_head(list); arpt != NULL;
+	    arpt = list_next(list, arpt), i++) {
+		arpt_ent_t *ent = &idx->ents[i];
+
+		strlcpy(ent->icao, arpt->icao, sizeof (ent->icao));
+		ent->ecef = arpt->ecef;
+		ent->cell = ecef2cell(ent->ecef);
+	}
+	free_nearest_airport_list(list);
+	qsort(idx->ents, idx->n_ents, sizeof (*idx->ents), ent_compar);
+	idx->center = pos2ecef(pos);
+
+	unload_distant_airport_tiles(svc.db, pos);
+}
+
+/*
+ * Copies the surface layout of airport `icao' out of the airport database.
+ * If the airport isn't known, the returned surface is empty. Worker
+ * thread only.
+ */
+static arpt_surf_t *
+surf_build(const char *icao)
+{
+	arpt_surf_t *surf = calloc(1, sizeof (*surf));
+	airport_t *arpt = airport_lookup_by_icao(svc.db, icao);
+	size_t i;
+
+	strlcpy(surf->icao, icao, sizeof (surf->icao));
+	if (arpt == NULL)
+		return (surf);
+
+	surf->n_rwys = avl_numnodes(&arpt->rwys);
+	surf->rwys = calloc(MAX(surf->n_rwys, 1), sizeof (*surf->rwys));
+	i = 0;
+	for (runway_t *rwy = avl_first(&arpt->rwys); rwy != NULL;
+	    rwy = AVL_NEXT(&arpt->rwys, rwy), i++) {
+		surf->rwys[i].thr[0] = GEO3_TO_GEO2(rwy->ends[0].thr);
+		surf->rwys[i].thr[1] = GEO3_TO_GEO2(rwy->ends[1].thr);
+		surf->rwys[i].width = rwy->width;
+	}
+
+	surf->n_ramps = avl_numnodes(&arpt->ramp_starts);
+	surf->ramps = calloc(MAX(surf->n_ramps, 1), sizeof (*surf->ramps));
+	i = 0;
+	for (ramp_start_t *rs = avl_first(&arpt->ramp_starts);
+	    rs != NULL; rs = AVL_NEXT(&arpt->ramp_starts, rs), i++) {
+		surf->ramps[i].pos = rs->pos;
+		surf->ramps[i].hdg = rs->hdg_true;
+	}
+
+	return (surf);
+}
+
+static void
+cache_builder(void *arg)
+{
+	cache_build_t *cb = arg;
+	bool_t ok = recreate_cache(&cb->db);
+
+	mutex_enter(&build_lock);
+	cb->done = B_TRUE;
+	cb->ok = ok;
+	mutex_exit(&build_lock);
+}
+
+/*
+ * Kicks off the cache build, unless one left running by a previous
+ * arpt_svc_fini is still around. That one is working on the same cache
+ * directory, so starting another one would have the two fight over it.
+ */
+static bool_t
+cache_build_start(void)
+{
+	cache_build_t *cb;
+
+	if (!build_lock_inited) {
+		mutex_init(&build_lock);
+		build_lock_inited = B_TRUE;
+	}
+	if (build != NULL)
+		return (B_TRUE);
+
+	cb = calloc(1, sizeof (*cb));
+	airportdb_create(&cb->db, svc.db->xpdir, svc.db->cachedir);
+	if (!thread_create(&cb->thr, cache_builder, cb)) {
+		airportdb_destroy(&cb->db);
+		free(cb);
+		return (B_FALSE);
+	}
+	build = cb;
+
+	return (B_TRUE);
+}
+
+/*
+ * Returns B_TRUE once the cache build has finished and disposes of it,
+ * passing its outcome back in `ok' (if not NULL). If `wait' is set, this
+ * waits for the build to finish.
+ */
+static bool_t
+cache_build_collect(bool_t wait, bool_t *ok)
+{
+	bool_t done;
+
+	ASSERT(build != NULL);
+
+	mutex_enter(&build_lock);
+	done = build->done;
+	mutex_exit(&build_lock);
+	if (!done && !wait)
+		return (B_FALSE);
+
+	thread_join(&build->thr);
+	if (ok != NULL)
+		*ok = build->ok;
+	airportdb_destroy(&build->db);
+	free(build);
+	build = NULL;
+
+	return (B_TRUE);
+}
+
+static void
+worker(void *unused)
+{
+	bool_t built = B_FALSE;
+
+	UNUSED(unused);
+
+	mutex_enter(&svc.lock);
+	while (!svc.shutdown && !cache_build_collect(B_FALSE, &built)) {
+		cv_timedwait(&svc.worker_cv, &svc.lock, microclock() +
+		    SEC2USEC(BUILD_POLL_INTVAL));
+	}
+	if (svc.shutdown) {
+		mutex_exit(&svc.lock);
+		return;
+	}
+	mutex_exit(&svc.lock);
+
+	/*
+	 * With the cache now current, this merely loads it. Nobody else
+	 * touches the database until we've flagged it as ready, so there's
+	 * no need to hold the lock for this.
+	 */
+	if (built)
+		built = recreate_cache(svc.db);
+	if (!built) {
+		logMsg("Error building the airport database cache, airport "
+		    "dependent features will be unavailable");
+	}
+
+	mutex_enter(&svc.lock);
+	svc.ready = built;
+	svc.failed = !built;
+	/* without a database, there's no work to be done */
+	while (!svc.shutdown && !svc.ready)
+		cv_wait(&svc.worker_cv, &svc.lock);
+	while (!svc.shutdown) {
+		geo_pos2_t pos = svc.req_pos;
+
+		if (svc.surf_icao[0] != 0) {
+			char icao[8];
+			arpt_surf_t *surf;
+
+			strlcpy(icao, svc.surf_icao, sizeof (icao));
+			svc.surf_icao[0] = 0;
+			mutex_exit(&svc.lock);
+			surf = surf_build(icao);
+			mutex_enter(&svc.lock);
+
+			arpt_surf_free(svc.surf);
+			svc.surf = surf;
+			continue;
+		}
+
+		if (!IS_NULL_GEO_POS(pos) &&
+		    !idx_covers(&svc.idx, pos2ecef(pos))) {
+			arpt_idx_t idx;
+
+			mutex_exit(&svc.lock);
+			idx_build(&idx, pos);
+			mutex_enter(&svc.lock);
+
+			idx_free(&svc.idx);
+			svc.idx = idx;
+			continue;
+		}
+		cv_timedwait(&svc.worker_cv, &svc.lock, microclock() +
+		    SEC2USEC(WORKER_INTVAL));
+	}
+	mutex_exit(&svc.lock);
+}
+
+static float
+svc_floop(float elapsed, float elapsed2, int counter, void *refcon)
+{
+	UNUSED(elapsed);
+	UNUSED(elapsed2);
+	UNUSED(counter);
+	UNUSED(refcon);
+
+	/* Airports are of no interest to us while flying */
+	if (dr_geti(&drs.onground_any) == 1) {
+		geo_pos2_t pos = GEO_POS2(dr_getf(&drs.lat),
+		    dr_getf(&drs.lon));
+
+		mutex_enter(&svc.lock);
+		svc.req_pos = pos;
+		if (!idx_covers(&svc.idx, pos2ecef(pos)))
+			cv_broadcast(&svc.worker_cv);
+		mutex_exit(&svc.lock);
+	}
+
+	return (POLL_INTVAL);
+}
+
+bool_t
+arpt_svc_init(airportdb_t *db)
+{
+	XPLMCreateFlightLoop_t floop = {
+	    .structSize = sizeof (floop),
+	    .phase = xplm_FlightLoop_Phase_AfterFlightModel,
+	    .callbackFunc = svc_floop,
+	    .refcon = NULL
+	};
+
+	ASSERT(db != NULL);
+
+	if (svc.inited)
+		return (B_TRUE);
+
+	memset(&svc, 0, sizeof (svc));
+	svc.db = db;
+	svc.req_pos = NULL_GEO_POS2;
+	svc.idx.center = NULL_VECT3;
+	mutex_init(&svc.lock);
+	cv_init(&svc.worker_cv);
+
+	fdr_find(&drs.lat, "sim/flightmodel/position/latitude");
+	fdr_find(&drs.lon, "sim/flightmodel/position/longitude");
+	fdr_find(&drs.onground_any, "sim/flightmodel/failures/onground_any");
+
+	if (!cache_build_start()) {
+		logMsg("Error creating airport database cache build thread");
+		cv_destroy(&svc.worker_cv);
+		mutex_destroy(&svc.lock);
+		return (B_FALSE);
+	}
+	if (!thread_create(&svc.worker, worker, NULL)) {
+		logMsg("Error creating airport service thread");
+		cv_destroy(&svc.worker_cv);
+		mutex_destroy(&svc.lock);
+		return (B_FALSE);
+	}
+
+	svc.floop = XPLMCreateFlightLoop(&floop);
+	XPLMScheduleFlightLoop(svc.floop, -1, 0);
+
+	svc.inited = B_TRUE;
+
+	return (B_TRUE);
+}
+
+/*
+ * Returns B_TRUE once arpt_svc_find_nearest's answer for `pos' is final,
+ * i.e. the airport database is ready and the index covers `pos' (or the
+ * database failed to build, in which case there's nothing to wait for).
+ * Otherwise asks the worker to index `pos' and returns B_FALSE.
+ */
+bool_t
+arpt_svc_ready(geo_pos2_t pos)
+{
+	bool_t ready;
+
+	ASSERT(svc.inited);
+
+	mutex_enter(&svc.lock);
+	ready = (svc.failed ||
+	    (svc.ready && idx_covers(&svc.idx, pos2ecef(pos))));
+	if (!ready) {
+		svc.req_pos = pos;
+		cv_broadcast(&svc.worker_cv);
+	}
+	mutex_exit(&svc.lock);
+
+	return (ready);
+}
+
+/*
+ * Doesn't wait for an airport database cache build that's still in
+ * progress. That's left running for the next arpt_svc_init to pick up,
+ * or for arpt_svc_stop to wait for.
+ */
+void
+arpt_svc_fini(void)
+{
+	if (!svc.inited)
+		return;
+
+	XPLMDestroyFlightLoop(svc.floop);
+
+	mutex_enter(&svc.lock);
+	svc.shutdown = B_TRUE;
+	cv_broadcast(&svc.worker_cv);
+	mutex_exit(&svc.lock);
+	thread_join(&svc.worker);
+	/* dispose of a build that finished after the worker had quit */
+	if (build != NULL)
+		(void) cache_build_collect(B_FALSE, NULL);
+
+	idx_free(&svc.idx);
+	arpt_surf_free(svc.surf);
+	cv_destroy(&svc.worker_cv);
+	mutex_destroy(&svc.lock);
+
+	svc.inited = B_FALSE;
+}
+
+/*
+ * Called from XPluginStop, after arpt_svc_fini. Waits for an airport
+ * database cache build left running by arpt_svc_fini to finish, as no
+ * thread of ours may outlive the plugin.
+ */
+void
+arpt_svc_stop(void)
+{
+	ASSERT(!svc.inited);
+
+	if (!build_lock_inited)
+		return;
+	if (build != NULL) {
+		logMsg("Waiting for the airport database cache build to "
+		    "finish");
+		(void) cache_build_collect(B_TRUE, NULL);
+	}
+	mutex_destroy(&build_lock);
+	build_lock_inited = B_FALSE;
+}
+
+/*
+ * Locates the airport nearest to `pos', but no further than `max_dist'
+ * meters away (which can be at most MAX_QUERY_DIST). Returns B_TRUE and
+ * fills in `icao' if a suitable airport was found, otherwise `icao' is
+ * set to an empty string and B_FALSE is returned. This never blocks: if
+ * the airport database isn't ready yet, or the index doesn't cover `pos'
+ * (e.g. we've been repositioned), we report that there's no airport
+ * nearby. In the latter case, the worker is asked to rebuild the index,
+ * so retrying a little later will find the airport.
+ */
+bool_t
+arpt_svc_find_nearest(geo_pos2_t pos, double max_dist, char icao[8])
+{
+	vect3_t pos_ecef = pos2ecef(pos);
+	double min_dist = max_dist;
+	int64_t c = ecef2cell(pos_ecef);
+
+	ASSERT(svc.inited);
+	ASSERT3F(max_dist, <=, MAX_QUERY_DIST);
+
+	*icao = 0;
+
+	mutex_enter(&svc.lock);
+
+	if (!svc.ready) {
+		mutex_exit(&svc.lock);
+		return (B_FALSE);
+	}
+	if (!idx_covers(&svc.idx, pos_ecef)) {
+		svc.req_pos = pos;
+		cv_broadcast(&svc.worker_cv);
+		mutex_exit(&svc.lock);
+		return (B_FALSE);
+	}
+
+	/*
+	 * Since CELL_SZ == MAX_QUERY_DIST, all airports within max_dist
+	 * are in the 3x3x3 block of cells around our own cell.
+	 */
+	for (int dx = -1; dx <= 1; dx++) {
+		for (int dy = -1; dy <= 1; dy++) {
+			for (int dz = -1; dz <= 1; dz++) {
+				arpt_ent_t srch;
+				const arpt_ent_t *ent;
+				int64_t x = ((c >> (2 * CELL_BITS)) + dx) &
+				    CELL_MASK;
+				int64_t y = ((c >> CELL_BITS) + dy) & CELL_MASK;
+				int64_t z = (c + dz) & CELL_MASK;
+
+				if (svc.idx.n_ents == 0)
+					continue;
+				srch.cell = (x << (2 * CELL_BITS)) |
+				    (y << CELL_BITS) | z;
+				ent = bsearch(&srch, svc.idx.ents,
+				    svc.idx.n_ents, sizeof (*ent), ent_compar);
+				if (ent == NULL)
+					continue;
+				/* bsearch may land anywhere in the run */
+				while (ent > svc.idx.ents &&
+				    ent[-1].cell == srch.cell)
+					ent--;
+				for (; ent < &svc.idx.ents[svc.idx.n_ents] &&
+				    ent->cell == srch.cell; ent++) {
+					double d = vect3_dist(ent->ecef,
+					    pos_ecef);
+					if (d < min_dist) {
+						strlcpy(icao, ent->icao, 8);
+						min_dist = d;
+					}
+				}
+			}
+		}
+	}
+
+	mutex_exit(&svc.lock);
+
+	return (*icao != 0);
+}
+
+/*
+ * Asks the worker to extract the surface layout of airport `icao'. The
+ * result can be picked up using arpt_svc_collect_surf once it's ready.
+ */
+void
+arpt_svc_request_surf(const char *icao)
+{
+	ASSERT(svc.inited);
+	ASSERT(icao != NULL);
+
+	mutex_enter(&svc.lock);
+	strlcpy(svc.surf_icao, icao, sizeof (svc.surf_icao));
+	cv_broadcast(&svc.worker_cv);
+	mutex_exit(&svc.lock);
+}
+
+/*
+ * Returns the airport surface built in response to arpt_svc_request_surf,
+ * or NULL if it isn't ready yet. The caller takes ownership of the
+ * returned surface and must free it using arpt_surf_free.
+ */
+arpt_surf_t *
+arpt_svc_collect_surf(void)
+{
+	arpt_surf_t *surf;
+
+	ASSERT(svc.inited);
+
+	mutex_enter(&svc.lock);
+	surf = svc.surf;
+	svc.surf = NULL;
+	mutex_exit(&svc.lock);
+
+	return (surf);
+}
+
+void
+arpt_surf_free(arpt_surf_t *surf)
+{
+	if (surf == NULL)
+		return;
+	free(surf->rwys);
+	free(surf->ramps);
+	free(surf);
+}
@@ -0,0 +1,63 @@
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+*/
+/*
+ * Copyright 2020 Saso Kiselkov. All rights reserved.
+ */
+
+#ifndef	_ARPT_SVC_H_
+#define	_ARPT_SVC_H_
+
+#include <acfutils/airportdb.h>
+#include <acfutils/geom.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+	geo_pos2_t	thr[2];		/* runway end thresholds */
+	double		width;		/* meters */
+} arpt_rwy_t;
+
+typedef struct {
+	geo_pos2_t	pos;
+	double		hdg;		/* true heading, degrees */
+} arpt_ramp_t;
+
+/* Self-contained copy of the surface layout of an airport */
+typedef struct {
+	char		icao[8];
+	arpt_rwy_t	*rwys;
+	size_t		n_rwys;
+	arpt_ramp_t	*ramps;
+	size_t		n_ramps;
+} arpt_surf_t;
+
+bool_t arpt_svc_init(airportdb_t *db);
+void arpt_svc_fini(void);
+void arpt_svc_stop(void);
+bool_t arpt_svc_ready(geo_pos2_t pos);
+
+bool_t arpt_svc_find_nearest(geo_pos2_t pos, double max_dist, char icao[8]);
+
+void arpt_svc_request_surf(const char *icao);
+arpt_surf_t *arpt_svc_collect_surf(void);
+void arpt_surf_free(arpt_surf_t *surf);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _ARPT_SVC_H_ */
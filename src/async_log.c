@@ -0,0 +1,258 @@
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+*/
+/*
+ * Copyright 2020 Saso Kiselkov. All rights reserved.
+ */
+
+/*
+ * Asynchronous log output. async_log_write is installed as libacfutils'
+ * log function, so every logMsg ends up here. Instead of writing to
+ * Log.txt right away (XPLMDebugString flushes the file on every call),
+ * messages are placed into a bounded queue which a background thread
+ * hands over to XPLMDebugString.
+ *
+ * To keep a misbehaving code path from flooding the log, consecutive
+ * identical messages are collapsed into a single "repeated N times"
+ * note. If the queue fills up, further messages are dropped and the
+ * number of dropped messages is reported once space frees up again.
+ *
+ * libacfutils' assertion failures are logged through here as well (along
+ * with a backtrace) and are immediately followed by an abort. So once we
+ * see one, we drain the queue and write out everything that follows
+ * synchronously, before the process goes down.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <XPLMUtilities.h>
+
+#include <acfutils/assert.h>
+#include <acfutils/helpers.h>
+#include <acfutils/thread.h>
+#include <acfutils/time.h>
+
+#include "async_log.h"
+
+#define	QUEUE_LEN		256	/* messages */
+#define	REPEAT_REPORT_INTVAL	SEC2USEC(10)	/* microseconds */
+#define	FLUSH_INTVAL		SEC2USEC(1)	/* microseconds */
+
+static struct {
+	bool_t		inited;
+	bool_t		sync;		/* bypass the queue */
+	bool_t		thr_started;
+	thread_t	thr;
+	mutex_t		lock;
+	condvar_t	cv;
+	bool_t		shutdown;
+	bool_t		writing;	/* log_thr is writing out a batch */
+
+	char		*queue[QUEUE_LEN];
+	unsigned	q_head;		/* next message to write out */
+	unsigned	q_len;
+	unsigned	dropped;
+
+	char		*last_msg;	/* last message enqueued */
+	unsigned	repeats;	/* times last_msg was suppressed */
+	uint64_t	repeat_start_t;
+} alog;
+
+/* Caller must hold alog.lock */
+static void
+enqueue(char *str)
+{
+	if (alog.q_len == QUEUE_LEN) {
+		alog.dropped++;
+		free(str);
+		return;
+	}
+	alog.queue[(alog.q_head + alog.q_len) % QUEUE_LEN] = str;
+	alog.q_len++;
+}
+
+/* Caller must hold alog.lock */
+static void
+flush_repeats(void)
+{
+	if (alog.repeats == 0)
+		return;
+	enqueue(sprintf_alloc("BetterPushback: last message repeated "
+	    "%u times\n", alog.repeats));
+	alog.repeats = 0;
+}
+
+/*
+ * Takes all queued messages off the queue and writes them out. Caller
+ * must hold alog.lock, which is dropped while writing.
+ */
+static void
+write_queue(void)
+{
+	char *batch[QUEUE_LEN];
+	unsigned n = 0;
+
+	while (alog.q_len != 0) {
+		batch[n++] = alog.queue[alog.q_head];
+		alog.q_head = (alog.q_head + 1) % QUEUE_LEN;
+		alog.q_len--;
+	}
+	if (alog.dropped != 0) {
+		unsigned dropped = alog.dropped;
+
+		alog.dropped = 0;
+		enqueue(sprintf_alloc("BetterPushback: log queue full, "
+		    "%u messages dropped\n", dropped));
+	}
+
+	alog.writing = B_TRUE;
+	mutex_exit(&alog.lock);
+	for (unsigned i = 0; i < n; i++) {
+		XPLMDebugString(batch[i]);
+		free(batch[i]);
+	}
+	mutex_enter(&alog.lock);
+	alog.writing = B_FALSE;
+	cv_broadcast(&alog.cv);
+}
+
+static void
+log_thr(void *unused)
+{
+	UNUSED(unused);
+
+	mutex_enter(&alog.lock);
+	while (!alog.shutdown) {
+		write_queue();
+		/* don't hold on to a repeat report forever */
+		if (alog.repeats != 0 && microclock() - alog.repeat_start_t >
+		    REPEAT_REPORT_INTVAL)
+			flush_repeats();
+		if (alog.q_len == 0 && !alog.shutdown) {
+			cv_timedwait(&alog.cv, &alog.lock, microclock() +
+			    FLUSH_INTVAL);
+		}
+	}
+	flush_repeats();
+	while (alog.q_len != 0)
+		write_queue();
+	mutex_exit(&alog.lock);
+}
+
+/*
+ * libacfutils' assertion macros log "<file>:<line>: assertion ... failed"
+ * right before aborting.
+ */
+static bool_t
+is_assert_msg(const char *str)
+{
+	const char *p = strstr(str, ": assertion ");
+
+	return (p != NULL && strstr(p, " failed") != NULL);
+}
+
+/*
+ * Called with alog.lock held when we're about to go down. Gets everything
+ * still queued (or being written out by log_thr) into the log and makes
+ * all further messages bypass the queue.
+ */
+static void
+drain_sync(void)
+{
+	alog.sync = B_TRUE;
+	flush_repeats();
+	while (alog.q_len != 0 || alog.writing) {
+		if (alog.q_len != 0)
+			write_queue();
+		else
+			cv_wait(&alog.cv, &alog.lock);
+	}
+}
+
+void
+async_log_init(void)
+{
+	if (alog.inited)
+		return;
+
+	memset(&alog, 0, sizeof (alog));
+	mutex_init(&alog.lock);
+	cv_init(&alog.cv);
+	alog.thr_started = thread_create(&alog.thr, log_thr, NULL);
+	if (!alog.thr_started) {
+		XPLMDebugString("BetterPushback: error creating log thread, "
+		    "logging synchronously\n");
+		alog.sync = B_TRUE;
+	}
+	alog.inited = B_TRUE;
+}
+
+/*
+ * Stops the log thread, writing out all messages still in the queue.
+ * Afterwards, async_log_write falls back to writing synchronously.
+ */
+void
+async_log_fini(void)
+{
+	if (!alog.inited)
+		return;
+
+	if (alog.thr_started) {
+		mutex_enter(&alog.lock);
+		alog.shutdown = B_TRUE;
+		cv_broadcast(&alog.cv);
+		mutex_exit(&alog.lock);
+		thread_join(&alog.thr);
+	}
+	free(alog.last_msg);
+	cv_destroy(&alog.cv);
+	mutex_destroy(&alog.lock);
+	memset(&alog, 0, sizeof (alog));
+}
+
+void
+async_log_write(const char *str)
+{
+	if (!alog.inited) {
+		XPLMDebugString(str);
+		return;
+	}
+
+	mutex_enter(&alog.lock);
+
+	if (!alog.sync && is_assert_msg(str))
+		drain_sync();
+	if (alog.sync) {
+		mutex_exit(&alog.lock);
+		XPLMDebugString(str);
+		return;
+	}
+
+	if (alog.last_msg != NULL && strcmp(alog.last_msg, str) == 0) {
+		if (alog.repeats++ == 0)
+			alog.repeat_start_t = microclock();
+		mutex_exit(&alog.lock);
+		return;
+	}
+
+	flush_repeats();
+	free(alog.last_msg);
+	alog.last_msg = strdup(str);
+	enqueue(strdup(str));
+	cv_broadcast(&alog.cv);
+
+	mutex_exit(&alog.lock);
+}
@@ -0,0 +1,34 @@
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+*/
+/*
+ * Copyright 2020 Saso Kiselkov. All rights reserved.
+ */
+
+#ifndef	_ASYNC_LOG_H_
+#define	_ASYNC_LOG_H_
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+void async_log_init(void);
+void async_log_fini(void);
+void async_log_write(const char *str);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _ASYNC_LOG_H_ */
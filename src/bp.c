@@ -41,17 +41,22 @@
 #include <acfutils/dr.h>
 #include <acfutils/geom.h>
 #include <acfutils/glew.h>
-#include <acfutils/intl.h>
 #include <acfutils/math.h>
 #include <acfutils/list.h>
 #include <acfutils/perf.h>
 #include <acfutils/time.h>
 #include <acfutils/wav.h>
 
+#include "acf_profile.h"
+#include "arpt_svc.h"
 #include "bp.h"
 #include "bp_cam.h"
 #include "cfg.h"
+#include "force_ctl.h"
 #include "msg.h"
+#include "sc_sync.h"
+#include "telemetry.h"
+#include "xlate_cat.h"
 #include "xplane.h"
 
 /*#define	PB_DEBUG_INTF*/
@@ -66,7 +71,6 @@
 #define	NORMAL_ACCEL		0.25	/* m/s^2 */
 #define	NORMAL_DECEL		0.17	/* m/s^2 */
 #define	BRAKE_PEDAL_THRESH	0.03	/* brake pedal angle, 0..1 */
-#define	FORCE_PER_TON		5000	/* max push force per ton, Newtons */
 /*
  * X-Plane 10's tire model is a bit less forgiving of slow creeping,
  * so bump the minimum breakaway speed on that version.
@@ -84,6 +88,7 @@
 #define	PB_CONN_LIFT_DELAY	13.0	/* seconds */
 #define	PB_CONN_LIFT_DURATION	9.0	/* seconds */
 #define	PB_START_DELAY		5	/* seconds */
+#define	PB_ARPT_WAIT_TIMEOUT	30	/* seconds */
 #define	PB_DRIVING_TURN_OFFSET	15	/* meters */
 #define	PB_LIFT_TE		0.075	/* fraction */
 #define	STATE_TRANS_DELAY	2	/* seconds, state transition delay */
@@ -166,8 +171,9 @@ bp_long_state_t bp_ls;
 
 static bool_t inited = B_FALSE;
 static XPLMFlightLoopID	bp_floop = NULL;
+static XPLMProbeRef slope_probe = NULL;
 
-static bool_t read_acf_file_info(void);
+static void read_acf_file_info(const acf_props_t *props);
 static float bp_run(float elapsed, float elapsed2, int counter, void *refcon);
 static void bp_complete(void);
 static void tug_pos_update(vect2_t my_pos, double my_hdg, bool_t pos_only);
@@ -178,14 +184,32 @@ static int recon_handler(XPLMCommandRef, XPLMCommandPhase, void *);
 
 static bool_t radio_volume_warn = B_FALSE;
 
+/*
+ * Session-independent resources (datarefs, voice messages and the
+ * aircraft outline) survive bp_fini, so consecutive pushbacks and
+ * opening the planner don't have to reload them. They are only dropped in
+ * bp_warm_flush, which gets called when the aircraft changes or the
+ * plugin is disabled. Voice messages are additionally reloaded when the
+ * nearest airport or language preference changes. The button icons don't
+ * depend on the aircraft at all, so their atlas is kept until the plugin
+ * is disabled (see load_buttons).
+ */
+static struct {
+	bool_t		drs_found;
+	bool_t		msgs_loaded;
+	char		msgs_icao[8];
+	char		msgs_lang[32];
+	lang_pref_t	msgs_lang_pref;
+} warm;
+
 static const acf_info_t incompatible_acf[] = {
     { .acf = NULL, .author = NULL }
 };
 
 static XPLMCommandRef disco_cmd = NULL, recon_cmd = NULL;
 static button_t disco_buttons[2] = {
-	{ .filename = "disconnect.png", .vk = -1, .tex = 0, .tex_data = NULL },
-	{ .filename = "reconnect.png", .vk = -1, .tex = 0, .tex_data = NULL },
+	{ .filename = "disconnect.png", .vk = -1 },
+	{ .filename = "reconnect.png", .vk = -1 },
 };
 
 /*
@@ -400,35 +424,27 @@ acf_is_felis_tu154m(void)
  * Locates the airport nearest to our current location, but which is also
  * within 10km (MAX_ARPT_DIST). If a suitable airport is found, its ICAO
  * code is placed in the return argument `icao' and the function returns
- * B_TRUE. Otherwise the variable is left untouched and B_FALSE is returned.
+ * B_TRUE. Otherwise `icao' is set to an empty string and B_FALSE is
+ * returned.
  */
 bool_t
 find_nearest_airport(char icao[8])
 {
-	geo_pos2_t my_pos = GEO_POS2(dr_getf(&drs.lat), dr_getf(&drs.lon));
-	vect3_t my_pos_ecef = geo2ecef_mtr(GEO_POS3(my_pos.lat, my_pos.lon, 0),
-	    &wgs84);
-	list_t *list;
-	airport_t *arpt;
-	double min_dist = 1e10;
-
-	*icao = 0;
-
-	load_nearest_airport_tiles(airportdb, my_pos);
-	list = find_nearest_airports(airportdb, my_pos);
-
-	for (arpt = list_head(list); arpt != NULL;
-	    arpt = list_next(list, arpt)) {
-		double dist = vect3_dist(arpt->ecef, my_pos_ecef);
-		if (dist < min_dist) {
-			strlcpy(icao, arpt->icao, sizeof (arpt->icao));
-			min_dist = dist;
-		}
-	}
-	free_nearest_airport_list(list);
-	unload_distant_airport_tiles(airportdb, NULL_GEO_POS2);
+	return (arpt_svc_find_nearest(GEO_POS2(dr_getf(&drs.lat),
+	    dr_getf(&drs.lon)), MAX_ARPT_DIST, icao));
+}
 
-	return (*icao != 0);
+/*
+ * Returns B_TRUE once find_nearest_airport's answer for our current
+ * location is final (see arpt_svc_ready). Until then, choices depending
+ * on the nearest airport should be held off, rather than made for no
+ * airport at all.
+ */
+bool_t
+nearest_airport_ready(void)
+{
+	return (arpt_svc_ready(GEO_POS2(dr_getf(&drs.lat),
+	    dr_getf(&drs.lon))));
 }
 
 static void
@@ -597,12 +613,34 @@ tug_speed(void)
 	return (vect2_dotprod(u, v));
 }
 
+/*
+ * Returns the terrain slope (in degrees) underneath the aircraft along its
+ * longitudinal axis. Positive means the ground rises ahead of the aircraft.
+ */
+static double
+ground_slope(void)
+{
+	XPLMProbeInfo_t info = { .structSize = sizeof (info) };
+	vect2_t dir = hdg2dir(bp.cur_pos.hdg);
+
+	if (slope_probe == NULL)
+		slope_probe = XPLMCreateProbe(xplm_ProbeY);
+	if (XPLMProbeTerrainXYZ(slope_probe, dr_getf(&drs.local_x),
+	    dr_getf(&drs.local_y), dr_getf(&drs.local_z), &info) !=
+	    xplm_ProbeHitTerrain || info.normalY <= 0)
+		return (0);
+	/* X-Plane's Z axis is flipped to ours */
+	return (RAD2DEG(atan(-(info.normalX * dir.x - info.normalZ * dir.y) /
+	    info.normalY)));
+}
+
 static void
 push_at_speed(double targ_speed, double max_accel, bool_t allow_snd_ctl,
     bool_t decelerating)
 {
-	double force_lim, force_incr, force, accel_now, d_v, Fx, Fz, steer;
-	double cur_spd, nose_down_moment;
+	double force_lim, force_incr, force, Fx, Fz, steer;
+	double nose_down_moment, mass;
+	force_ctl_in_t in;
 
 	VERIFY3S(dr_getvf(&drs.tire_steer_cmd, &steer, bp.acf.nw_i, 1), ==, 1);
 
@@ -622,16 +660,11 @@ push_at_speed(double targ_speed, double max_accel, bool_t allow_snd_ctl,
 
 	/*
 	 * Multiply force limit by weight in tons - that's at most how
-	 * hard we'll try to push the aircraft. This prevents us from
-	 * flinging the aircraft across the tarmac in case some external
-	 * factor is blocking us (like chocks).
-	 */
-	force_lim = FORCE_PER_TON * (dr_getf(&drs.acf_mass) / 1000);
-
-	/*
-	 * Scale the maximum force increment by frame time. This means it'll
-	 * take up to 1s for us to apply full pushback force.
+	 * hard we'll try to push the aircraft. Scale the maximum force
+	 * increment by frame time.
 	 */
+	mass = dr_getf(&drs.acf_mass);
+	force_lim = force_ctl_max_force(mass);
 	force_incr = force_lim * bp.d_t;
 
 	/*
@@ -640,52 +673,28 @@ push_at_speed(double targ_speed, double max_accel, bool_t allow_snd_ctl,
 	 * longitudinal speed based on nosewheel steering angle.
 	 */
 	if (bp_xp_ver >= 11000) {
-		cur_spd = tug_speed();
-		accel_now = (bp.d_pos.spd / cos(DEG2RAD(fabs(steer)))) / bp.d_t;
+		in.cur_spd = tug_speed();
+		in.accel = (bp.d_pos.spd / cos(DEG2RAD(fabs(steer)))) / bp.d_t;
 	} else {
 		/*
 		 * XP10's buggy sticky tire model prevents us from reducing
 		 * longitudinal speed below MIN_SPEED_XP10, so make sure we
 		 * keep the speed up above that value.
 		 */
-		cur_spd = bp.cur_pos.spd;
-		accel_now = bp.d_pos.spd / bp.d_t;
-	}
-
-	force = bp.last_force;
-	d_v = targ_speed - cur_spd;
-
-	/*
-	 * This is some fudge needed to get some high-thrust aircraft
-	 * going, otherwise we'll just jitter in-place due to thinking
-	 * we're overdoing acceleration.
-	 */
-	if (ABS(cur_spd) < BREAKAWAY_THRESH)
-		max_accel *= 100;
-
-	if (d_v > 0) {		/* speed up */
-		/*
-		 * Modulate the acceleration to reach our target speed smoothly,
-		 * unless we're trying to decelerate or we've not yet broken
-		 * away (to prevent jumpiness on XP10's sticky tires).
-		 */
-		if (d_v < max_accel && !decelerating &&
-		    ABS(bp.cur_pos.spd) >= BREAKAWAY_THRESH)
-			max_accel = d_v;
-		if (accel_now > max_accel)
-			force -= force_incr;
-		else if (accel_now < max_accel)
-			force += force_incr;
-	} else if (d_v < 0) {	/* slow down */
-		max_accel *= -1;
-		if (d_v > max_accel && !decelerating &&
-		    ABS(bp.cur_pos.spd) >= BREAKAWAY_THRESH)
-			max_accel = d_v;
-		if (accel_now < max_accel)
-			force += force_incr;
-		else if (accel_now > max_accel)
-			force -= force_incr;
-	}
+		in.cur_spd = bp.cur_pos.spd;
+		in.accel = bp.d_pos.spd / bp.d_t;
+	}
+	in.mass = mass;
+	in.targ_spd = targ_speed;
+	in.max_accel = max_accel;
+	in.slope = ground_slope();
+	in.last_force = bp.last_force;
+	in.breakaway_spd = BREAKAWAY_THRESH;
+	in.decelerating = decelerating;
+	/* the nose gear lift-off protection below skews the response */
+	in.learn_roll_res = (bp.tug_weight_force == 0);
+	in.d_t = bp.d_t;
+	force = force_ctl_step(&bp.fctl, &in);
 
 	/*
 	 * Calculate the vector components of our force on the aircraft
@@ -731,19 +740,16 @@ push_at_speed(double targ_speed, double max_accel, bool_t allow_snd_ctl,
 			 * the problem.
 			 */
 			if (force < 0)
-				force += 2 * force_incr;
+				force = MIN(force + 2 * force_incr, 0);
 			else
-				force -= 2 * force_incr;
+				force = MAX(force - 2 * force_incr, 0);
+			force_ctl_reset(&bp.fctl);
 		} else {
 			bp.tug_weight_force = 0;
 		}
 	}
 	dr_setf(&drs.rot_force_M, nose_down_moment);
 
-	/* Don't overstep the force limits for this aircraft */
-	force = MIN(force_lim, force);
-	force = MAX(-force_lim, force);
-
 	bp.last_force = force;
 
 	if (allow_snd_ctl) {
@@ -842,9 +848,20 @@ read_gear_info(void)
 	return (B_TRUE);
 }
 
+static bool_t
+is_helicopter(void)
+{
+	return (bp.acf.model_flags.is_helicopter ||
+	    bp.acf.model_flags.fly_like_a_helo);
+}
+
 static bool_t
 bp_state_init(void)
 {
+	char my_acf[512], my_path[512];
+	acf_profile_t *prof;
+	double acf_max_steer;
+
 	memset(&bp, 0, sizeof (bp));
 	list_create(&bp.segs, sizeof (seg_t), offsetof(seg_t, node));
 
@@ -857,20 +874,63 @@ bp_state_init(void)
 		return (B_FALSE);
 	}
 
-	if (!read_acf_file_info()) {
-		XPLMSpeakString(_("Pushback failure: error reading aircraft "
-		    "files from disk."));
-		return (B_FALSE);
+	XPLMGetNthAircraftModel(0, my_acf, my_path);
+	/*
+	 * Try the aircraft profile cache first. If that fails, go the long
+	 * way around, parse the .acf file and then remember the result for
+	 * next time.
+	 */
+	prof = acf_profile_load(my_path, bp_ls.outline == NULL);
+	if (prof != NULL) {
+		bp.acf = prof->acf;
+		if (bp_ls.outline == NULL) {
+			bp_ls.outline = prof->outline;
+			prof->outline = NULL;
+		}
+		acf_profile_free(prof);
+	} else {
+		/*
+		 * Parse the .acf file only once and pull everything we
+		 * need out of the resulting property table.
+		 */
+		acf_props_t *props = acf_props_read(my_path);
+
+		if (props == NULL) {
+			XPLMSpeakString(_("Pushback failure: error reading "
+			    "aircraft files from disk."));
+			return (B_FALSE);
+		}
+		read_acf_file_info(props);
+		if (bp_ls.outline == NULL && !is_helicopter())
+			bp_ls.outline = acf_outline_read(props);
+		acf_props_free(props);
+
+		/* helicopters are refused below */
+		if (!is_helicopter()) {
+			if (bp_ls.outline == NULL) {
+				XPLMSpeakString(_("Pushback failure: error "
+				    "reading aircraft files from disk."));
+				return (B_FALSE);
+			}
+			(void) acf_profile_store(my_path, &bp.acf,
+			    bp_ls.outline);
+		}
 	}
-	if (bp.acf.model_flags.is_helicopter ||
-	    bp.acf.model_flags.fly_like_a_helo) {
+	if (is_helicopter()) {
 		XPLMSpeakString(_("Pushback failure: Are you seriously "
 		    "trying to call pushback for a helicopter?"));
 		return (B_FALSE);
 	}
 
+	/*
+	 * The gear & steering info comes from datarefs, which depend on the
+	 * aircraft's current state and can be overridden by its plugins, so
+	 * it's never cached in the profile.
+	 */
 	if (!read_gear_info())
 		return (B_FALSE);
+	acf_max_steer = MAX(dr_getf(&drs.nw_steerdeg1),
+	    dr_getf(&drs.nw_steerdeg2));
 
 	bp.veh.wheelbase = bp.acf.main_z - bp.acf.nw_z;
 	bp.veh.fixed_z_off = -bp.acf.main_z;	/* X-Plane's Z is negative */
@@ -880,8 +940,7 @@ bp_state_init(void)
 		return (B_FALSE);
 	}
 
-	bp.veh.max_steer = MIN(MAX(dr_getf(&drs.nw_steerdeg1),
-	    dr_getf(&drs.nw_steerdeg2)), max_steer_angle());
+	bp.veh.max_steer = MIN(acf_max_steer, max_steer_angle());
 	/*
 	 * Some aircraft have a broken declaration here and only declare the
 	 * high-speed rudder steering angle. For those, ignore what they say
@@ -902,6 +961,7 @@ bp_state_init(void)
 	 * origin point.
 	 */
 	bp.veh.use_rear_pos = B_TRUE;
+	force_ctl_init(&bp.fctl, dr_getf(&drs.acf_mass));
 
 	bp.step = PB_STEP_OFF;
 	bp.step_start_t = 0;
@@ -914,14 +974,27 @@ audio_sys_init(void)
 {
 	lang_pref_t	lang_pref = LANG_PREF_MATCH_REAL;
 	char		icao[8];
+	const char	*lang = bp_get_lang();
 
 	find_nearest_airport(icao);
 	(void) conf_get_i(bp_conf, "lang_pref", (int *)&lang_pref);
-	if (!msg_init(bp_get_lang(), icao, lang_pref)) {
+
+	if (warm.msgs_loaded && strcmp(warm.msgs_icao, icao) == 0 &&
+	    strcmp(warm.msgs_lang, lang) == 0 &&
+	    warm.msgs_lang_pref == lang_pref)
+		return (B_TRUE);
+
+	msg_fini();
+	warm.msgs_loaded = B_FALSE;
+	if (!msg_init(lang, icao, lang_pref)) {
 		XPLMSpeakString(_("Pushback failure: error initialising audio "
 		    "messages. Please reinstall BetterPushback."));
 		return (B_FALSE);
 	}
+	strlcpy(warm.msgs_icao, icao, sizeof (warm.msgs_icao));
+	strlcpy(warm.msgs_lang, lang, sizeof (warm.msgs_lang));
+	warm.msgs_lang_pref = lang_pref;
+	warm.msgs_loaded = B_TRUE;
 
 	return (B_TRUE);
 }
@@ -974,102 +1047,36 @@ bp_shut_fini(void)
 }
 
 /*
- * Reads the aircraft's .acf file and grabs the info we want from it.
+ * Grabs the info we want from the aircraft's .acf file properties.
  */
-static bool_t
-read_acf_file_info(void)
+static void
+read_acf_file_info(const acf_props_t *props)
 {
-	char my_acf[512], my_path[512];
-	FILE *fp;
-	char *line = NULL;
-	size_t cap = 0;
-	bool_t parsing_props = B_FALSE;
-
-	XPLMGetNthAircraftModel(0, my_acf, my_path);
-	fp = fopen(my_path, "rb");
-	if (fp == NULL) {
-		logMsg("Error reading %s: %s", my_acf, strerror(errno));
-		return (B_FALSE);
-	}
-
 #define	PARSE_FLAG_PARAM(flag) \
 	do { \
-		size_t n; \
-		char **comps = strsplit(line, " ", B_TRUE, &n); \
-		if (n != 3) { \
-			free_strlist(comps, n); \
-			continue; \
-		} \
-		sscanf(comps[2], "%d", &bp.acf.model_flags.flag); \
-		free_strlist(comps, n); \
+		const char *str = acf_props_find(props, "acf/_" #flag); \
+		if (str != NULL) \
+			bp.acf.model_flags.flag = (atoi(str) != 0); \
 	} while (0)
 
-	while (getline(&line, &cap, fp) > 0) {
-		strip_space(line);
-		if (!parsing_props) {
-			if (strcmp(line, "PROPERTIES_BEGIN") == 0)
-				parsing_props = B_TRUE;
-			continue;
-		}
-		if (strcmp(line, "PROPERTIES_END") == 0)
-			break;
-		if (strstr(line, "acf/_is_airliner") != NULL)
-			PARSE_FLAG_PARAM(is_airliner);
-		else if (strstr(line, "acf/_is_experimental") != NULL)
-			PARSE_FLAG_PARAM(is_experimental);
-		else if (strstr(line, "acf/_is_general_aviation") != NULL)
-			PARSE_FLAG_PARAM(is_general_aviation);
-		else if (strstr(line, "acf/_is_glider") != NULL)
-			PARSE_FLAG_PARAM(is_glider);
-		else if (strstr(line, "acf/_is_helicopter") != NULL)
-			PARSE_FLAG_PARAM(is_helicopter);
-		else if (strstr(line, "acf/_is_military") != NULL)
-			PARSE_FLAG_PARAM(is_military);
-		else if (strstr(line, "acf/_is_sci_fi") != NULL)
-			PARSE_FLAG_PARAM(is_sci_fi);
-		else if (strstr(line, "acf/_is_seaplane") != NULL)
-			PARSE_FLAG_PARAM(is_seaplane);
-		else if (strstr(line, "acf/_is_ultralight") != NULL)
-			PARSE_FLAG_PARAM(is_ultralight);
-		else if (strstr(line, "acf/_is_vtol") != NULL)
-			PARSE_FLAG_PARAM(is_vtol);
-		else if (strstr(line, "acf/_fly_like_a_helo") != NULL)
-			PARSE_FLAG_PARAM(fly_like_a_helo);
-	}
+	PARSE_FLAG_PARAM(is_airliner);
+	PARSE_FLAG_PARAM(is_experimental);
+	PARSE_FLAG_PARAM(is_general_aviation);
+	PARSE_FLAG_PARAM(is_glider);
+	PARSE_FLAG_PARAM(is_helicopter);
+	PARSE_FLAG_PARAM(is_military);
+	PARSE_FLAG_PARAM(is_sci_fi);
+	PARSE_FLAG_PARAM(is_seaplane);
+	PARSE_FLAG_PARAM(is_ultralight);
+	PARSE_FLAG_PARAM(is_vtol);
+	PARSE_FLAG_PARAM(fly_like_a_helo);
 
 #undef	PARSE_FLAG_PARAM
-
-	fclose(fp);
-
-	return (B_TRUE);
 }
 
-bool_t
-bp_init(void)
+static void
+find_drs(void)
 {
-	const char *reason;
-	dr_t radio_vol, sound_on;
-	char my_acf[512], my_path[512];
-
-	/*
-	 * Due to numerous spurious bug reports of missing ground crew audio,
-	 * check that the user hasn't turned down the radio volume and just
-	 * forgotten about it. Warn the user if the volume is very low.
-	 */
-	fdr_find(&sound_on, "sim/operation/sound/sound_on");
-	fdr_find(&radio_vol, "sim/operation/sound/radio_volume_ratio");
-	if (dr_getf(&radio_vol) < MIN_RADIO_VOLUME_THRESH &&
-	    dr_geti(&sound_on) == 1 && !radio_volume_warn) {
-		XPLMSpeakString(_("Pushback advisory: you have your radio "
-		    "volume turned very low and may not be able to hear "
-		    "ground crew. Please increase your radio volume in "
-		    "the X-Plane sound preferences."));
-		radio_volume_warn = B_TRUE;
-	}
-
-	if (inited)
-		return (B_TRUE);
-
 	memset(&drs, 0, sizeof (drs));
 
 	fdr_find(&drs.lbrake, "sim/cockpit2/controls/left_brake_ratio");
@@ -1134,6 +1141,49 @@ bp_init(void)
 
 	fdr_find(&drs.author, "sim/aircraft/view/acf_author");
 	fdr_find(&drs.sim_paused, "sim/time/paused");
+}
+
+bool_t
+bp_init(void)
+{
+	const char *reason;
+	dr_t radio_vol, sound_on;
+
+	/*
+	 * Due to numerous spurious bug reports of missing ground crew audio,
+	 * check that the user hasn't turned down the radio volume and just
+	 * forgotten about it. Warn the user if the volume is very low.
+	 */
+	fdr_find(&sound_on, "sim/operation/sound/sound_on");
+	fdr_find(&radio_vol, "sim/operation/sound/radio_volume_ratio");
+	if (dr_getf(&radio_vol) < MIN_RADIO_VOLUME_THRESH &&
+	    dr_geti(&sound_on) == 1 && !radio_volume_warn) {
+		XPLMSpeakString(_("Pushback advisory: you have your radio "
+		    "volume turned very low and may not be able to hear "
+		    "ground crew. Please increase your radio volume in "
+		    "the X-Plane sound preferences."));
+		radio_volume_warn = B_TRUE;
+	}
+
+	if (inited) {
+		/*
+		 * Our voice messages might have been flushed (see
+		 * bp_msgs_flush), or they and the button icons might no
+		 * longer match the language or nearest airport. Both are
+		 * keyed by those, so this is cheap if nothing has changed.
+		 * Don't swap out the voice messages under a running pushback.
+		 */
+		if (bp_started || (audio_sys_init() &&
+		    load_buttons(disco_buttons, ARRAY_NUM_ELEM(disco_buttons))))
+			return (B_TRUE);
+		bp_fini();
+		return (B_FALSE);
+	}
+
+	if (!warm.drs_found) {
+		find_drs();
+		warm.drs_found = B_TRUE;
+	}
 
 	XPLMRegisterCommandHandler(disco_cmd, disco_handler, 1, NULL);
 	XPLMRegisterCommandHandler(recon_cmd, recon_handler, 1, NULL);
@@ -1148,14 +1198,8 @@ bp_init(void)
 
 	if (!bp_state_init())
 		goto errout;
-	if (!audio_sys_init() || !load_buttons() ||
-	    !load_icon(&disco_buttons[0]) || !load_icon(&disco_buttons[1]))
-		goto errout;
-
-	XPLMGetNthAircraftModel(0, my_acf, my_path);
-
-	bp_ls.outline = acf_outline_read(my_path);
-	if (bp_ls.outline == NULL)
+	if (!audio_sys_init() ||
+	    !load_buttons(disco_buttons, ARRAY_NUM_ELEM(disco_buttons)))
 		goto errout;
 
 	inited = B_TRUE;
@@ -1164,14 +1208,6 @@ bp_init(void)
 errout:
 	XPLMUnregisterCommandHandler(disco_cmd, disco_handler, 1, NULL);
 	XPLMUnregisterCommandHandler(recon_cmd, recon_handler, 1, NULL);
-	msg_fini();
-	unload_buttons();
-	unload_icon(&disco_buttons[0]);
-	unload_icon(&disco_buttons[1]);
-	if (bp_ls.outline != NULL) {
-		acf_outline_free(bp_ls.outline);
-		bp_ls.outline = NULL;
-	}
 	return (B_FALSE);
 }
 
@@ -1281,8 +1317,10 @@ bp_start(void)
 		bp_floop = XPLMCreateFlightLoop(&floop);
 	XPLMScheduleFlightLoop(bp_floop, -1, 1);
 
-	if (!slave_mode && !late_plan_requested)
+	if (!slave_mode && !late_plan_requested) {
 		route_save(&bp.segs);
+		sc_sync_route_publish(&bp.segs);
+	}
 
 	bp_started = B_TRUE;
 	bp_conf_set_save_enabled(!bp_started);
@@ -1325,34 +1363,60 @@ bp_fini(void)
 	if (!inited)
 		return;
 
-	if (bp_ls.outline != NULL) {
-		acf_outline_free(bp_ls.outline);
-		bp_ls.outline = NULL;
-	}
-
 	if (bp_floop != NULL) {
 		XPLMDestroyFlightLoop(bp_floop);
 		bp_floop = NULL;
 	}
+	if (slope_probe != NULL) {
+		XPLMDestroyProbe(slope_probe);
+		slope_probe = NULL;
+	}
 
 	XPLMUnregisterCommandHandler(disco_cmd, disco_handler, 1, NULL);
 	XPLMUnregisterCommandHandler(recon_cmd, recon_handler, 1, NULL);
 
-	msg_fini();
 	bp_complete();
 
 	/* segs have been released in bp_complete */
 	list_destroy(&bp.segs);
 
-	unload_icon(&disco_buttons[0]);
-	unload_icon(&disco_buttons[1]);
-	unload_buttons();
-
 	radio_volume_warn = B_FALSE;
 
 	inited = B_FALSE;
 }
 
+/*
+ * Unloads the voice messages, so they're reloaded on the next bp_init
+ * (even if we're still initialized). This also closes the voice message
+ * output device.
+ */
+void
+bp_msgs_flush(void)
+{
+	msg_fini();
+	warm.msgs_loaded = B_FALSE;
+}
+
+/*
+ * Drops all the session-independent resources kept around by bp_init.
+ * Must be called when the aircraft changes, or before the plugin gets
+ * disabled. Implies bp_fini.
+ */
+void
+bp_warm_flush(void)
+{
+	bp_fini();
+
+	bp_msgs_flush();
+	bp_cam_acf_sym_flush();
+	if (bp_ls.outline != NULL) {
+		acf_outline_free(bp_ls.outline);
+		bp_ls.outline = NULL;
+	}
+	memset(&drs, 0, sizeof (drs));
+	warm.drs_found = B_FALSE;
+}
+
 static bool_t
 nearing_end(void)
 {
@@ -1424,6 +1488,7 @@ bp_run_push(void)
 			dr_setf(&drs.axial_force, 0);
 			dr_setf(&drs.rot_force_N, 0);
 			bp.last_force = 0;
+			force_ctl_reset(&bp.fctl);
 			break;
 		}
 		/*
@@ -1493,6 +1558,7 @@ bp_complete(void)
 	bp_conf_set_save_enabled(!bp_started);
 	late_plan_requested = B_FALSE;
 	plan_complete = B_FALSE;
+	sc_sync_reset();
 
 	if (bp_ls.tug != NULL) {
 		tug_free(bp_ls.tug);
@@ -1529,6 +1595,24 @@ late_plan_end_cond(void)
 	    !bp_cam_is_running()) || (slave_mode && plan_complete));
 }
 
+/*
+ * The tug's livery and the voice accent depend on the nearest airport, so
+ * before loading the tug, we give the airport service a chance to find it
+ * (e.g. right after a reposition, or while the airport database is still
+ * being built). Returns B_TRUE once we're done waiting.
+ */
+static bool_t
+tug_load_arpt_wait(void)
+{
+	if (nearest_airport_ready())
+		return (B_TRUE);
+	if (bp.cur_t - bp.step_start_t < PB_ARPT_WAIT_TIMEOUT)
+		return (B_FALSE);
+	logMsg("Nearest airport still unknown after %d seconds, using a "
+	    "generic tug and voices", PB_ARPT_WAIT_TIMEOUT);
+	return (B_TRUE);
+}
+
 static bool_t
 pb_step_tug_load(void)
 {
@@ -1536,6 +1620,17 @@ pb_step_tug_load(void)
 		char icao[8] = { 0 };
 		char airline[1024] = { 0 };
 
+		if (!tug_load_arpt_wait())
+			return (B_TRUE);
+		/*
+		 * Our voice messages were picked when the nearest airport
+		 * might not have been known yet. No message has been played
+		 * yet, so it's safe to swap them out here.
+		 */
+		if (!audio_sys_init()) {
+			bp_complete();
+			return (B_FALSE);
+		}
 		(void) find_nearest_airport(icao);
 		if (acf_is_airliner())
 			read_acf_airline(airline);
@@ -1574,6 +1669,13 @@ pb_step_tug_load(void)
 		if (ext == NULL || strcmp(&ext[1], "tug") != 0)
 			return (B_TRUE);
 
+		if (!tug_load_arpt_wait())
+			return (B_TRUE);
+		/* same as above */
+		if (!audio_sys_init()) {
+			bp_complete();
+			return (B_FALSE);
+		}
 		(void) find_nearest_airport(icao);
 
 		if (acf_is_airliner())
@@ -1876,6 +1978,7 @@ pb_step_lift(void)
 			if (!slave_mode) {
 				plan_complete = B_TRUE;
 				route_save(&bp.segs);
+				sc_sync_route_publish(&bp.segs);
 			}
 		}
 
@@ -1913,11 +2016,15 @@ pb_step_connected(void)
 			}
 		} else {
 			/*
-			 * Since we don't know the segs, we'll just
-			 * assume it's going to be backward (as that's
-			 * the most likely direction anyhow).
+			 * Go by the master's route if it has been synced
+			 * to us. Otherwise we'll just assume it's going to
+			 * be backward (as that's the most likely direction
+			 * anyhow).
 			 */
-			msg_play(MSG_START_PB);
+			seg_t *seg = list_head(&bp.segs);
+
+			msg_play(seg == NULL || seg->backward ?
+			    MSG_START_PB : MSG_START_TOW);
 		}
 
 		bp.step++;
@@ -2589,6 +2696,104 @@ tug_pos_update(vect2_t my_pos, double my_hdg, bool_t pos_only)
 	}
 }
 
+static void
+bp_telem(void)
+{
+	telem_sample_t *s = telem_begin(TELEM_SRC_BP);
+	const seg_t *seg;
+
+	if (s == NULL)
+		return;
+	if ((seg = list_head(&bp.segs)) != NULL) {
+		s->seg_type = seg->type;
+		if (seg->backward)
+			s->flags |= TELEM_FLAG_BACKWARD;
+	}
+	s->x = bp.cur_pos.pos.x;
+	s->y = bp.cur_pos.pos.y;
+	s->hdg = bp.cur_pos.hdg;
+	s->spd = bp.cur_pos.spd;
+	s->steer = bp.last_steer;
+	s->force = bp.last_force;
+	s->wheelbase = bp.veh.wheelbase;
+	s->accel = bp.d_pos.spd / bp.d_t;
+	telem_commit();
+}
+
+/*
+ * Predicts which voice messages the upcoming steps are going to play, so
+ * the message system can have them decoded by the time we need them.
+ */
+static void
+bp_msg_prefetch(void)
+{
+	message_t next[2];
+	size_t n = 0;
+
+	if (bp.step == bp.msg_step)
+		return;
+	bp.msg_step = bp.step;
+
+	switch (bp.step) {
+	case PB_STEP_TUG_LOAD:
+	case PB_STEP_START:
+		next[n++] = MSG_DRIVING_UP;
+		break;
+	case PB_STEP_DRIVING_UP_CLOSE:
+	case PB_STEP_OPENING_CRADLE:
+		next[n++] = MSG_RDY2CONN;
+		next[n++] = MSG_RDY2CONN_NOPARK;
+		break;
+	case PB_STEP_WAITING_FOR_PBRAKE:
+	case PB_STEP_DRIVING_UP_CONNECT:
+		if (bp_ls.tug->info->lift_type == LIFT_WINCH)
+			next[n++] = MSG_WINCH;
+		else
+			next[n++] = MSG_CONNECTED;
+		break;
+	case PB_STEP_GRABBING:
+	case PB_STEP_LIFTING:
+		if (bp_ls.tug->info->lift_type != LIFT_WINCH)
+			next[n++] = MSG_CONNECTED;
+		break;
+	case PB_STEP_CONNECTED:
+		if (!slave_mode) {
+			const seg_t *seg = list_head(&bp.segs);
+			bool_t back = (seg == NULL || seg->backward);
+
+			/* whether we can start might still change, get both */
+			next[n++] = (back ? MSG_START_PB : MSG_START_TOW);
+			next[n++] = (back ? MSG_START_PB_NOSTART :
+			    MSG_START_TOW_NOSTART);
+		} else {
+			const seg_t *seg = list_head(&bp.segs);
+
+			next[n++] = (seg == NULL || seg->backward ?
+			    MSG_START_PB : MSG_START_TOW);
+		}
+		break;
+	case PB_STEP_STARTING:
+	case PB_STEP_PUSHING:
+	case PB_STEP_STOPPING:
+		next[n++] = MSG_OP_COMPLETE;
+		break;
+	case PB_STEP_STOPPED:
+		next[n++] = MSG_DISCO;
+		break;
+	case PB_STEP_LOWERING:
+	case PB_STEP_UNGRABBING:
+	case PB_STEP_WAITING4OK2DISCO:
+	case PB_STEP_MOVING_AWAY:
+	case PB_STEP_CLOSING_CRADLE:
+		next[n++] = MSG_DONE_RIGHT;
+		next[n++] = MSG_DONE_LEFT;
+		break;
+	default:
+		break;
+	}
+	msg_prefetch(next, n);
+}
+
 static float
 bp_run(float elapsed, float elapsed2, int counter, void *refcon)
 {
@@ -2612,6 +2817,10 @@ bp_run(float elapsed, float elapsed2, int counter, void *refcon)
 	bp.d_pos.hdg = rel_hdg(bp.last_pos.hdg, bp.cur_pos.hdg);
 	bp.d_pos.spd = bp.cur_pos.spd - bp.last_pos.spd;
 	bp.d_t = bp.cur_t - bp.last_t;
+	telem_set_frame(bp.cur_t, bp.step);
+	/* mirror the master's route (see sc_sync.c) */
+	if (slave_mode)
+		(void) sc_sync_route_update(&bp.segs);
 
 	ASSERT(bp_ls.tug != NULL || bp.step <= PB_STEP_TUG_LOAD);
 	if (bp_ls.tug != NULL) {
@@ -2625,6 +2834,13 @@ bp_run(float elapsed, float elapsed2, int counter, void *refcon)
 		    bp.step >= PB_STEP_GRABBING &&
 		    bp.step <= PB_STEP_UNGRABBING)
 			tug_pos_update(bp.cur_pos.pos, bp.cur_pos.hdg, B_FALSE);
+
+		if (slave_mode) {
+			(void) sc_sync_state_apply(bp.step, &bp.cur_pos,
+			    bp_ls.tug);
+		} else {
+			sc_sync_state_publish(bp.step, &bp.cur_pos, bp_ls.tug);
+		}
 	}
 
 	if (!slave_mode) {
@@ -2866,6 +3082,8 @@ bp_run(float elapsed, float elapsed2, int counter, void *refcon)
 	bp.last_pos = bp.cur_pos;
 	bp.last_t = bp.cur_t;
 	dr_getvf(&drs.tire_steer_cmd, &bp.last_steer, bp.acf.nw_i, 1);
+	bp_msg_prefetch();
+	bp_telem();
 
 	return (-1);
 }
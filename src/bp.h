@@ -26,6 +26,7 @@
 
 #include "acf_outline.h"
 #include "driving.h"
+#include "force_ctl.h"
 #include "tug.h"
 
 #ifdef	__cplusplus
@@ -120,9 +121,12 @@ typedef struct {
 	double		last_force;
 	double		tug_weight_force;
 
+	force_ctl_t	fctl;		/* push_at_speed force controller */
+
 	pushback_step_t	step;		/* current PB step */
 	double		step_start_t;	/* PB step start time */
 	double		last_voice_t;	/* last voice message start time */
+	pushback_step_t	msg_step;	/* step messages were prefetched for */
 
 	double		reverse_t;	/* when reversing direction */
 
@@ -158,6 +162,8 @@ void bp_shut_fini(void);
 
 bool_t bp_init(void);
 void bp_fini(void);
+void bp_warm_flush(void);
+void bp_msgs_flush(void);
 
 bool_t bp_start(void);
 bool_t bp_stop(void);
@@ -170,6 +176,7 @@ bool_t acf_is_compatible(void);
 bool_t acf_is_airliner(void);
 void read_acf_airline(char airline[1024]);
 bool_t find_nearest_airport(char icao[8]);
+bool_t nearest_airport_ready(void);
 
 extern bool_t late_plan_requested;
 
@@ -25,9 +25,6 @@
 
 #include <string.h>
 #include <stddef.h>
-#include <errno.h>
-
-#include <png.h>
 
 #include <XPLMCamera.h>
 #include <XPLMGraphics.h>
@@ -42,7 +39,6 @@
 #include <acfutils/dr.h>
 #include <acfutils/geom.h>
 #include <acfutils/glew.h>
-#include <acfutils/intl.h>
 #include <acfutils/math.h>
 #include <acfutils/list.h>
 #include <acfutils/time.h>
@@ -50,13 +46,18 @@
 
 #include <cglm/cglm.h>
 
+#include "arpt_overlay.h"
 #include "bp.h"
 #include "bp_cam.h"
 #include "driving.h"
+#include "icon_atlas.h"
+#include "pred_svc.h"
+#include "route_vbo.h"
+#include "terr_cache.h"
+#include "xlate_cat.h"
 #include "xplane.h"
 
 #define	MAX_PRED_DISTANCE	10000	/* meters */
-#define	ANGLE_DRAW_STEP		5
 #define	ORIENTATION_LINE_LEN	200
 
 #define	INCR_SMALL		5
@@ -85,6 +86,38 @@ static double		cam_height;
 static double		cam_hdg;
 static double		cursor_hdg;
 static list_t		pred_segs;
+static vect2_t		pred_start_pos;	/* where pred_segs starts */
+static double		pred_start_hdg;
+
+/* Everything which affects the hover prediction */
+typedef struct {
+	int		mouse_x, mouse_y;
+	double		cursor_hdg;
+	vect3_t		cam_pos;
+	double		cam_height;
+	double		cam_hdg;
+	vect2_t		start_pos;	/* end of the route */
+	double		start_hdg;
+} pred_input_t;
+static pred_input_t	pred_input;	/* last prediction was made for this */
+static bool_t		pred_input_valid = B_FALSE;
+
+/* Projection matrix & viewport, with the inverse cached for unprojecting */
+static struct {
+	bool_t		valid;
+	mat4		proj;
+	vec4		vp;
+	mat4		inv_proj;
+} unproj;
+static route_vbo_t	route_rv;	/* geometry of bp.segs */
+static route_vbo_t	pred_rv;	/* geometry of pred_segs */
+
+/* Aircraft symbol geometry, see acf_sym_build */
+static struct {
+	GLuint		vbo;
+	unsigned	n_lines;
+	unsigned	n_quads;
+} acf_sym;
 static XPLMCommandRef	circle_view_cmd;
 static XPLMWindowID	fake_win;
 static vect2_t		cursor_world_pos;
@@ -94,6 +127,8 @@ static int		saved_cloud_types[3];
 static bool_t		saved_real_wx;
 static XPLMObjectRef	cam_lamp_obj = NULL;
 static XPLMInstanceRef	cam_lamp_inst = NULL;
+static bool_t		arpt_overlay_pending = B_FALSE;
+static bool_t		view_only = B_FALSE;	/* slave: master's route */
 static const char	*cam_lamp_drefs[] = { NULL };
 
 static int key_sniffer(char inChar, XPLMKeyFlags inFlags, char inVirtualKey,
@@ -153,174 +188,43 @@ static view_cmd_info_t view_cmds[] = {
 };
 
 static button_t buttons[] = {
-    { .filename = "move_view.png", .vk = -1, .tex = 0, .tex_data = NULL },
-    { .filename = "place_seg.png", .vk = -1, .tex = 0, .tex_data = NULL },
-    { .filename = "rotate_seg.png", .vk = -1, .tex = 0, .tex_data = NULL },
-    { .filename = "", .vk = -1, .tex = 0, .tex_data = NULL, .h = 64 },
-    {
-	.filename = "accept_plan.png", .vk = XPLM_VK_RETURN, .tex = 0,
-	.tex_data = NULL
-    },
-    {
-	.filename = "delete_seg.png", .vk = XPLM_VK_DELETE, .tex = 0,
-	.tex_data = NULL
-    },
-    { .filename = "", .vk = -1, .tex = 0, .tex_data = NULL, .h = 64 },
-    {
-	.filename = "cancel_plan.png", .vk = XPLM_VK_ESCAPE, .tex = 0,
-	.tex_data = NULL
-    },
-    {
-	.filename = "conn_first.png", .vk = XPLM_VK_SPACE, .tex = 0,
-	.tex_data = NULL
-    },
+    { .filename = "move_view.png", .vk = -1 },
+    { .filename = "place_seg.png", .vk = -1 },
+    { .filename = "rotate_seg.png", .vk = -1 },
+    { .filename = "", .vk = -1, .h = 64 },
+    { .filename = "accept_plan.png", .vk = XPLM_VK_RETURN },
+    { .filename = "delete_seg.png", .vk = XPLM_VK_DELETE },
+    { .filename = "", .vk = -1, .h = 64 },
+    { .filename = "cancel_plan.png", .vk = XPLM_VK_ESCAPE },
+    { .filename = "conn_first.png", .vk = XPLM_VK_SPACE },
     { .filename = NULL }
 };
 static int button_hit = -1, button_lit = -1;
 static bool_t cam_inited = B_FALSE;
 
+/*
+ * Loads the icons of the planner buttons, plus the `n_extra' buttons in
+ * `extra', into the icon atlas for the current language. The atlas stays
+ * loaded until unload_buttons, so this is cheap if nothing has changed.
+ */
 bool_t
-load_icon(button_t *btn)
+load_buttons(button_t *extra, size_t n_extra)
 {
-	char *filename;
-	FILE *fp;
-	size_t rowbytes;
-	png_bytep *volatile rowp = NULL;
-	png_structp pngp = NULL;
-	png_infop infop = NULL;
-	volatile bool_t res = B_TRUE;
-	uint8_t header[8];
-
-	/* try the localized version first */
-	filename = mkpathname(bp_xpdir, bp_plugindir, "data", "icons",
-	    bp_get_lang(), btn->filename, NULL);
-	if (!file_exists(filename, NULL)) {
-		/* if the localized version failed, try the English version */
-		free(filename);
-		filename = mkpathname(bp_xpdir, bp_plugindir, "data", "icons",
-		    "en", btn->filename, NULL);
-	}
-	fp = fopen(filename, "rb");
-	if (fp == NULL) {
-		logMsg("Cannot open file %s: %s", filename, strerror(errno));
-		res = B_FALSE;
-		goto out;
-	}
-	if (fread(header, 1, sizeof (header), fp) != 8 ||
-	    png_sig_cmp(header, 0, sizeof (header)) != 0) {
-		logMsg("Cannot open file %s: invalid PNG header", filename);
-		res = B_FALSE;
-		goto out;
-	}
-	pngp = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
-	VERIFY(pngp != NULL);
-	infop = png_create_info_struct(pngp);
-	VERIFY(infop != NULL);
-	if (setjmp(png_jmpbuf(pngp))) {
-		logMsg("Cannot open file %s: libpng error in init_io",
-		    filename);
-		res = B_FALSE;
-		goto out;
-	}
-	png_init_io(pngp, fp);
-	png_set_sig_bytes(pngp, 8);
-
-	if (setjmp(png_jmpbuf(pngp))) {
-		logMsg("Cannot open file %s: libpng read info failed",
-		    filename);
-		res = B_FALSE;
-		goto out;
-	}
-	png_read_info(pngp, infop);
-	btn->w = png_get_image_width(pngp, infop);
-	btn->h = png_get_image_height(pngp, infop);
-
-	if (png_get_color_type(pngp, infop) != PNG_COLOR_TYPE_RGBA) {
-		logMsg("Bad icon file %s: need color type RGBA", filename);
-		res = B_FALSE;
-		goto out;
-	}
-	if (png_get_bit_depth(pngp, infop) != 8) {
-		logMsg("Bad icon file %s: need 8-bit depth", filename);
-		res = B_FALSE;
-		goto out;
-	}
-	rowbytes = png_get_rowbytes(pngp, infop);
-
-	rowp = malloc(sizeof (*rowp) * btn->h);
-	VERIFY(rowp != NULL);
-	for (int i = 0; i < btn->h; i++) {
-		rowp[i] = malloc(rowbytes);
-		VERIFY(rowp[i] != NULL);
-	}
-
-	if (setjmp(png_jmpbuf(pngp))) {
-		logMsg("Bad icon file %s: error reading image file", filename);
-		res = B_FALSE;
-		goto out;
-	}
-	png_read_image(pngp, rowp);
-
-	btn->tex_data = malloc(btn->h * rowbytes);
-	for (int i = 0; i < btn->h; i++)
-		memcpy(&btn->tex_data[i * rowbytes], rowp[i], rowbytes);
-
-	glGenTextures(1, &btn->tex);
-	glBindTexture(GL_TEXTURE_2D, btn->tex);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, btn->w, btn->h, 0, GL_RGBA,
-	    GL_UNSIGNED_BYTE, btn->tex_data);
-
-out:
-	if (pngp != NULL)
-		png_destroy_read_struct(&pngp, &infop, NULL);
-	if (rowp != NULL) {
-		for (int i = 0; i < btn->h; i++)
-			free(rowp[i]);
-		free(rowp);
-	}
-	if (fp != NULL)
-		fclose(fp);
-	free(filename);
-
-	return (res);
-}
+	button_t *btns[ARRAY_NUM_ELEM(buttons) - 1 + n_extra];
+	size_t n = 0;
 
-void
-unload_icon(button_t *btn)
-{
-	if (btn->tex != 0) {
-		glDeleteTextures(1, &btn->tex);
-		btn->tex = 0;
-	}
-	if (btn->tex_data != NULL) {
-		free(btn->tex_data);
-		btn->tex_data = NULL;
-	}
-}
-
-bool_t
-load_buttons(void)
-{
-	for (int i = 0; buttons[i].filename != NULL; i++) {
-		/* skip spacers */
-		if (strcmp(buttons[i].filename, "") == 0)
-			continue;
-		if (!load_icon(&buttons[i])) {
-			unload_buttons();
-			return (B_FALSE);
-		}
-	}
+	for (int i = 0; buttons[i].filename != NULL; i++)
+		btns[n++] = &buttons[i];
+	for (size_t i = 0; i < n_extra; i++)
+		btns[n++] = &extra[i];
 
-	return (B_TRUE);
+	return (icon_atlas_load(bp_get_lang(), btns, n));
 }
 
 void
 unload_buttons(void)
 {
-	for (int i = 0; buttons[i].filename != NULL; i++)
-		unload_icon(&buttons[i]);
+	icon_atlas_unload();
 }
 
 static int
@@ -368,25 +272,47 @@ get_vp(vec4 vp)
 }
 
 /*
- * Un-projects a viewport coordinate at X, Y using the current projection
- * matrix and figures out to which point on the reference plane it
- * corresponds. The reference plane is a plane that is parallel with the
- * Earth's surface at the local coordinate origin and is elevation-centered
- * on the aircraft's current local Y coordinate.
+ * Refreshes the cached projection matrix & viewport used by vp_unproject.
+ * The inverse projection matrix is only recomputed when either of them
+ * has actually changed, in which case B_TRUE is returned.
  */
-static void
-vp_unproject(double x, double y, double *x_phys, double *y_phys)
+static bool_t
+unproj_update(void)
 {
 	mat4 proj;
 	vec4 vp;
+
+	VERIFY3S(dr_getvf32(&drs.proj_matrix_3d, (float *)proj, 0, 16), ==, 16);
+	get_vp(vp);
+	if (unproj.valid && memcmp(proj, unproj.proj, sizeof (proj)) == 0 &&
+	    memcmp(vp, unproj.vp, sizeof (vp)) == 0)
+		return (B_FALSE);
+
+	memcpy(unproj.proj, proj, sizeof (proj));
+	memcpy(unproj.vp, vp, sizeof (vp));
+	glm_mat4_inv(proj, unproj.inv_proj);
+	unproj.valid = B_TRUE;
+
+	return (B_TRUE);
+}
+
+/*
+ * Un-projects a viewport coordinate at X, Y using the projection matrix
+ * cached by unproj_update and figures out to which point on the reference
+ * plane it corresponds. The reference plane is a plane that is parallel
+ * with the Earth's surface at the local coordinate origin and is
+ * elevation-centered on the aircraft's current local Y coordinate.
+ */
+static void
+vp_unproject(double x, double y, double *x_phys, double *y_phys)
+{
 	vec3 out_pt;
 
 	ASSERT(x_phys != NULL);
 	ASSERT(y_phys != NULL);
+	ASSERT(unproj.valid);
 
-	VERIFY3S(dr_getvf32(&drs.proj_matrix_3d, (float *)proj, 0, 16), ==, 16);
-	get_vp(vp);
-	glm_unproject((vec3){x, y, 0.5}, proj, vp, out_pt);
+	glm_unprojecti((vec3){x, y, 0.5}, unproj.inv_proj, unproj.vp, out_pt);
 	/*
 	 * To avoid having to figure out the viewport Z coordinate that
 	 * matches the reference plane distance, we scale the returned
@@ -403,14 +329,62 @@ vp_unproject(double x, double y, double *x_phys, double *y_phys)
 	*y_phys = out_pt[1];
 }
 
+/*
+ * Returns B_TRUE if `in' differs from the inputs the last prediction was
+ * requested for, and remembers `in' for the next comparison.
+ */
+static bool_t
+pred_input_changed(const pred_input_t *in)
+{
+	const pred_input_t *last = &pred_input;
+	bool_t changed = (!pred_input_valid ||
+	    in->mouse_x != last->mouse_x || in->mouse_y != last->mouse_y ||
+	    in->cursor_hdg != last->cursor_hdg ||
+	    !VECT3_EQ(in->cam_pos, last->cam_pos) ||
+	    in->cam_height != last->cam_height ||
+	    in->cam_hdg != last->cam_hdg ||
+	    !VECT2_EQ(in->start_pos, last->start_pos) ||
+	    in->start_hdg != last->start_hdg);
+
+	pred_input = *in;
+	pred_input_valid = B_TRUE;
+
+	return (changed);
+}
+
+/*
+ * Returns the scale at which the reference plane appears in the planner's
+ * top-down view, in pixels per meter.
+ */
+static double
+view_scale(mat4 proj)
+{
+	vec4 vp;
+
+	get_vp(vp);
+	/* proj[1][1] is the cotangent of half the vertical FOV */
+	return (proj[1][1] * (vp[3] / 2) / MAX(cam_height, 1));
+}
+
+/*
+ * Returns the radius (in meters) of a circle around the camera position
+ * which encloses everything visible on the reference plane.
+ */
+static double
+view_radius(mat4 proj)
+{
+	/* proj[0][0] & proj[1][1] are the cotangents of the half FOVs */
+	return (hypot(cam_height / proj[0][0], cam_height / proj[1][1]));
+}
+
 static int
 cam_ctl(XPLMCameraPosition_t *pos, int losing_control, void *refcon)
 {
-	int x, y;
 	double dx, dy, start_hdg;
 	vect2_t start_pos, end_pos;
 	seg_t *seg;
-	int n;
+	pred_input_t in;
+	bool_t vp_changed;
 
 	UNUSED(refcon);
 
@@ -425,19 +399,10 @@ cam_ctl(XPLMCameraPosition_t *pos, int losing_control, void *refcon)
 	pos->roll = 0;
 	pos->zoom = 1;
 
-	XPLMGetMouseLocation(&x, &y);
-	vp_unproject(x, y, &dx, &dy);
-
-	/*
-	 * Don't make predictions if due to the camera FOV angle (>= 180 deg)
-	 * we could be placing the prediction object very far away.
-	 */
-	if (dx > MAX_PRED_DISTANCE || dy > MAX_PRED_DISTANCE)
+	/* nothing to predict, we're only showing the master's route */
+	if (view_only)
 		return (1);
 
-	while ((seg = list_remove_head(&pred_segs)) != NULL)
-		free(seg);
-
 	seg = list_tail(&bp.segs);
 	if (seg != NULL) {
 		start_pos = seg->end_pos;
@@ -448,201 +413,161 @@ cam_ctl(XPLMCameraPosition_t *pos, int losing_control, void *refcon)
 		start_hdg = dr_getf(&drs.hdg);
 	}
 
+	/*
+	 * The prediction is computed in the background, we just draw the
+	 * latest one the worker has finished. If the route has changed
+	 * under the one we're showing, stop showing it.
+	 */
+	if (pred_svc_collect(&pred_segs, start_pos, start_hdg)) {
+		pred_start_pos = start_pos;
+		pred_start_hdg = start_hdg;
+	} else if (!VECT2_EQ(pred_start_pos, start_pos) ||
+	    pred_start_hdg != start_hdg) {
+		while ((seg = list_remove_head(&pred_segs)) != NULL)
+			free(seg);
+	}
+
+	/*
+	 * Only unproject the cursor & ask for a new prediction if something
+	 * that affects it has actually changed since the last frame.
+	 */
+	XPLMGetMouseLocation(&in.mouse_x, &in.mouse_y);
+	in.cursor_hdg = cursor_hdg;
+	in.cam_pos = cam_pos;
+	in.cam_height = cam_height;
+	in.cam_hdg = cam_hdg;
+	in.start_pos = start_pos;
+	in.start_hdg = start_hdg;
+	vp_changed = unproj_update();
+	if (!pred_input_changed(&in) && !vp_changed)
+		return (1);
+
+	vp_unproject(in.mouse_x, in.mouse_y, &dx, &dy);
+
+	/*
+	 * Don't make predictions if due to the camera FOV angle (>= 180 deg)
+	 * we could be placing the prediction object very far away.
+	 */
+	if (dx > MAX_PRED_DISTANCE || dy > MAX_PRED_DISTANCE)
+		return (1);
+
 	end_pos = vect2_add(VECT2(cam_pos.x, cam_pos.z),
 	    vect2_rot(VECT2(dx, dy), pos->heading));
 	cursor_world_pos = VECT2(end_pos.x, end_pos.y);
-
-	n = compute_segs(&bp.veh, start_pos, start_hdg, end_pos,
-	    cursor_hdg, &pred_segs);
-	if (n > 0) {
-		seg = list_tail(&pred_segs);
-		seg->user_placed = B_TRUE;
-	}
+	pred_svc_request(&bp.veh, start_pos, start_hdg, end_pos, cursor_hdg);
 
 	return (1);
 }
 
 static void
-draw_segment(const seg_t *seg)
+acf_sym_vtx(GLfloat *buf, unsigned *n, vect2_t v)
 {
-	XPLMProbeRef probe = XPLMCreateProbe(xplm_ProbeY);
-	XPLMProbeInfo_t info = { .structSize = sizeof (XPLMProbeInfo_t) };
-	double wing_long_off = bp.acf.main_z - bp_ls.outline->wingtip.y;
-	vect2_t wing_off_l = VECT2(-bp_ls.outline->semispan, wing_long_off);
-	vect2_t wing_off_r = VECT2(bp_ls.outline->semispan, wing_long_off);
-
-	switch (seg->type) {
-	case SEG_TYPE_STRAIGHT: {
-		float h1, h2;
-		vect2_t wing_l, wing_r, p;
-
-		VERIFY3U(XPLMProbeTerrainXYZ(probe, seg->start_pos.x, 0,
-		    -seg->start_pos.y, &info), ==, xplm_ProbeHitTerrain);
-		h1 = info.locationY;
-		VERIFY3U(XPLMProbeTerrainXYZ(probe, seg->end_pos.x, 0,
-		    -seg->end_pos.y, &info), ==, xplm_ProbeHitTerrain);
-		h2 = info.locationY;
-
-		glColor3f(0, 0, 1);
-		glLineWidth(3);
-		glBegin(GL_LINES);
-		glVertex3f(seg->start_pos.x, h1, -seg->start_pos.y);
-		glVertex3f(seg->end_pos.x, h2, -seg->end_pos.y);
-		glEnd();
-
-		wing_l = vect2_rot(wing_off_l, seg->start_hdg);
-		wing_r = vect2_rot(wing_off_r, seg->start_hdg);
-
-		glColor3f(1, 0.25, 1);
-		glLineWidth(2);
-		glBegin(GL_LINES);
-		p = vect2_add(seg->start_pos, wing_r);
-		glVertex3f(p.x, h1, -p.y);
-		p = vect2_add(seg->end_pos, wing_r);
-		glVertex3f(p.x, h1, -p.y);
-		p = vect2_add(seg->end_pos, wing_l);
-		glVertex3f(p.x, h1, -p.y);
-		p = vect2_add(seg->start_pos, wing_l);
-		glVertex3f(p.x, h1, -p.y);
-		glEnd();
-		break;
-	}
-	case SEG_TYPE_TURN: {
-		vect2_t c = vect2_add(seg->start_pos, vect2_scmul(
-		    vect2_norm(hdg2dir(seg->start_hdg), seg->turn.right),
-		    seg->turn.r));
-		vect2_t c2s = vect2_sub(seg->start_pos, c);
-		double s, e, rhdg;
-
-		rhdg = rel_hdg(seg->start_hdg, seg->end_hdg);
-		s = MIN(0, rhdg);
-		e = MAX(0, rhdg);
-		ASSERT3F(s, <=, e);
-		for (double a = s; a < e; a += ANGLE_DRAW_STEP) {
-			vect2_t p1, p2, p;
-			vect2_t wing1_l, wing1_r, wing2_l, wing2_r;
-			double step = MIN(ANGLE_DRAW_STEP, e - a);
-
-			wing1_l = vect2_rot(wing_off_l, seg->start_hdg + a);
-			wing1_r = vect2_rot(wing_off_r, seg->start_hdg + a);
-			wing2_l = vect2_rot(wing_off_l,
-			    seg->start_hdg + a + step);
-			wing2_r = vect2_rot(wing_off_r,
-			    seg->start_hdg + a + step);
-
-			p1 = vect2_add(c, vect2_rot(c2s, a));
-			p2 = vect2_add(c, vect2_rot(c2s, a + step));
-
-			VERIFY3U(XPLMProbeTerrainXYZ(probe, p1.x, 0, -p1.y,
-			    &info), ==, xplm_ProbeHitTerrain);
-
-			glColor3f(0, 0, 1);
-			glLineWidth(3);
-			glBegin(GL_LINES);
-			glVertex3f(p1.x, info.locationY, -p1.y);
-			glVertex3f(p2.x, info.locationY, -p2.y);
-			glEnd();
-
-			glColor3f(1, 0.25, 1);
-			glLineWidth(2);
-			glBegin(GL_LINES);
-			p = vect2_add(p1, wing1_r);
-			glVertex3f(p.x, info.locationY, -p.y);
-			p = vect2_add(p2, wing2_r);
-			glVertex3f(p.x, info.locationY, -p.y);
-			p = vect2_add(p1, wing1_l);
-			glVertex3f(p.x, info.locationY, -p.y);
-			p = vect2_add(p2, wing2_l);
-			glVertex3f(p.x, info.locationY, -p.y);
-			glEnd();
-		}
-		break;
-	}
-	}
-
-	XPLMDestroyProbe(probe);
+	buf[*n * 3] = v.x;
+	buf[*n * 3 + 1] = 0;
+	buf[*n * 3 + 2] = -(bp.acf.main_z - v.y);
+	(*n)++;
 }
 
+/*
+ * Builds the aircraft symbol's vertex buffer. The symbol is stored
+ * relative to the main gear at a heading of zero, so it only needs to
+ * be built once per aircraft. The outline (both halves) goes first as
+ * GL_LINES, followed by the gear footprint as GL_QUADS.
+ */
 static void
-draw_acf_symbol(vect3_t pos, double hdg, double wheelbase, vect3_t color)
+acf_sym_build(void)
 {
-	vect2_t v;
-	vect3_t p;
+	const acf_outline_t *outline = bp_ls.outline;
 	double tire_x[10], tire_z[10], tirrad[10];
+	GLfloat *buf;
+	unsigned n = 0;
 
-	/*
-	 * The wheelbase of most airlines is very roughly 1/3 of their
-	 * total length, so multiplying by 1.5 makes this value approx
-	 * half their size and gives a good rough "size ring" radius.
-	 */
-	wheelbase *= 1.5;
+	ASSERT3U(acf_sym.vbo, ==, 0);
 
-	glLineWidth(2);
-	glColor3f(color.x, color.y, color.z);
+	buf = calloc(outline->num_pts * 4 + bp.acf.n_gear * 4,
+	    3 * sizeof (*buf));
+	for (size_t i = 0; i + 1 < outline->num_pts; i++) {
+		vect2_t p1 = outline->pts[i], p2 = outline->pts[i + 1];
 
-	glBegin(GL_LINES);
-	for (size_t i = 0; i + 1 < bp_ls.outline->num_pts; i++) {
 		/* skip gaps in outline */
-		if (IS_NULL_VECT(bp_ls.outline->pts[i]) ||
-		    IS_NULL_VECT(bp_ls.outline->pts[i + 1]))
+		if (IS_NULL_VECT(p1) || IS_NULL_VECT(p2))
 			continue;
-
-		v = bp_ls.outline->pts[i];
-		v = vect2_rot(VECT2(v.x, bp.acf.main_z - v.y), hdg);
-		p = vect3_add(pos, VECT3(v.x, 0, v.y));
-		glVertex3f(p.x, p.y, -p.z);
-
-		v = bp_ls.outline->pts[i + 1];
-		v = vect2_rot(VECT2(v.x, bp.acf.main_z - v.y), hdg);
-		p = vect3_add(pos, VECT3(v.x, 0, v.y));
-		glVertex3f(p.x, p.y, -p.z);
-
-		v = bp_ls.outline->pts[i];
-		v = vect2_rot(VECT2(-v.x, bp.acf.main_z - v.y), hdg);
-		p = vect3_add(pos, VECT3(v.x, 0, v.y));
-		glVertex3f(p.x, p.y, -p.z);
-
-		v = bp_ls.outline->pts[i + 1];
-		v = vect2_rot(VECT2(-v.x, bp.acf.main_z - v.y), hdg);
-		p = vect3_add(pos, VECT3(v.x, 0, v.y));
-		glVertex3f(p.x, p.y, -p.z);
+		acf_sym_vtx(buf, &n, p1);
+		acf_sym_vtx(buf, &n, p2);
+		acf_sym_vtx(buf, &n, VECT2(-p1.x, p1.y));
+		acf_sym_vtx(buf, &n, VECT2(-p2.x, p2.y));
 	}
-	glEnd();
+	acf_sym.n_lines = n;
 
 	dr_getvf(&drs.tire_x, tire_x, 0, 10);
 	dr_getvf(&drs.tire_z, tire_z, 0, 10);
 	dr_getvf(&drs.tirrad, tirrad, 0, 10);
-
-	glBegin(GL_QUADS);
 	for (int i = 0; i < bp.acf.n_gear; i++) {
-		double tr = tirrad[bp.acf.gear_is[i]];
-		vect2_t c;
-
-		v = VECT2(tire_x[bp.acf.gear_is[i]],
-		    bp.acf.main_z - tire_z[bp.acf.gear_is[i]]);
-
-		c = vect2_rot(vect2_add(v, VECT2(-tr, -tr)), hdg);
-		p = vect3_add(pos, VECT3(c.x, 0, c.y));
-		glVertex3f(p.x, p.y, -p.z);
-		c = vect2_rot(vect2_add(v, VECT2(-tr, tr)), hdg);
-		p = vect3_add(pos, VECT3(c.x, 0, c.y));
-		glVertex3f(p.x, p.y, -p.z);
-		c = vect2_rot(vect2_add(v, VECT2(tr, tr)), hdg);
-		p = vect3_add(pos, VECT3(c.x, 0, c.y));
-		glVertex3f(p.x, p.y, -p.z);
-		c = vect2_rot(vect2_add(v, VECT2(tr, -tr)), hdg);
-		p = vect3_add(pos, VECT3(c.x, 0, c.y));
-		glVertex3f(p.x, p.y, -p.z);
+		int g = bp.acf.gear_is[i];
+		double tr = tirrad[g];
+		/* tire_z is in the same frame as the outline points */
+		vect2_t v = VECT2(tire_x[g], tire_z[g]);
+
+		acf_sym_vtx(buf, &n, vect2_add(v, VECT2(-tr, tr)));
+		acf_sym_vtx(buf, &n, vect2_add(v, VECT2(-tr, -tr)));
+		acf_sym_vtx(buf, &n, vect2_add(v, VECT2(tr, -tr)));
+		acf_sym_vtx(buf, &n, vect2_add(v, VECT2(tr, tr)));
 	}
-	glEnd();
+	acf_sym.n_quads = n - acf_sym.n_lines;
+
+	glGenBuffers(1, &acf_sym.vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, acf_sym.vbo);
+	glBufferData(GL_ARRAY_BUFFER, n * 3 * sizeof (*buf), buf,
+	    GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	free(buf);
+}
+
+/*
+ * Drops the aircraft symbol's vertex buffer. Must be called whenever the
+ * aircraft changes.
+ */
+void
+bp_cam_acf_sym_flush(void)
+{
+	if (acf_sym.vbo != 0) {
+		glDeleteBuffers(1, &acf_sym.vbo);
+		acf_sym.vbo = 0;
+	}
+}
+
+static void
+draw_acf_symbol(vect3_t pos, double hdg, vect3_t color)
+{
+	if (acf_sym.vbo == 0)
+		acf_sym_build();
+
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glTranslatef(pos.x, pos.y, -pos.z);
+	/* headings are clockwise, GL rotations counter-clockwise */
+	glRotatef(-hdg, 0, 1, 0);
+
+	glLineWidth(2);
+	glColor3f(color.x, color.y, color.z);
+
+	glBindBuffer(GL_ARRAY_BUFFER, acf_sym.vbo);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(3, GL_FLOAT, 0, NULL);
+	glDrawArrays(GL_LINES, 0, acf_sym.n_lines);
+	glDrawArrays(GL_QUADS, acf_sym.n_lines, acf_sym.n_quads);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glPopMatrix();
 }
 
 static int
 draw_prediction(XPLMDrawingPhase phase, int before, void *refcon)
 {
 	seg_t *seg;
-	XPLMProbeRef probe = XPLMCreateProbe(xplm_ProbeY);
-	XPLMProbeInfo_t info = { .structSize = sizeof (XPLMProbeInfo_t) };
+	double h, px_per_m;
 	mat4 view, proj;
 	XPLMDrawInfo_t di;
 	vec3 up = {sin(DEG2RAD(cam_hdg)), 0, -cos(DEG2RAD(cam_hdg))};
@@ -670,65 +595,65 @@ draw_prediction(XPLMDrawingPhase phase, int before, void *refcon)
 
 	XPLMSetGraphicsState(0, 0, 0, 0, 0, 0, 0);
 
-	for (seg = list_head(&bp.segs); seg != NULL;
-	    seg = list_next(&bp.segs, seg))
-		draw_segment(seg);
+	if (arpt_overlay_pending && nearest_airport_ready()) {
+		char icao[8];
 
-	for (seg = list_head(&pred_segs); seg != NULL;
-	    seg = list_next(&pred_segs, seg))
-		draw_segment(seg);
+		(void) find_nearest_airport(icao);
+		arpt_overlay_load(icao);
+		arpt_overlay_pending = B_FALSE;
+	}
+	/* our Z axis is flipped to X-Plane's */
+	arpt_overlay_draw(VECT2(cam_pos[0], -cam_pos[2]), view_radius(proj));
+
+	px_per_m = view_scale(proj);
+	route_vbo_update(&route_rv, &bp.segs, bp_ls.outline, bp.acf.main_z,
+	    px_per_m);
+	route_vbo_draw(&route_rv);
+	route_vbo_update(&pred_rv, &pred_segs, bp_ls.outline, bp.acf.main_z,
+	    px_per_m);
+	route_vbo_draw(&pred_rv);
 
 	if ((seg = list_tail(&pred_segs)) != NULL) {
 		vect2_t dir_v = hdg2dir(seg->end_hdg);
 		vect2_t x;
 
-		VERIFY3U(XPLMProbeTerrainXYZ(probe, seg->end_pos.x, 0,
-		    -seg->end_pos.y, &info), ==, xplm_ProbeHitTerrain);
+		h = terr_cache_height(seg->end_pos);
 		if (seg->type == SEG_TYPE_TURN || !seg->backward) {
 			glBegin(GL_LINES);
 			glColor3f(0, 1, 0);
-			glVertex3f(seg->end_pos.x, info.locationY,
-			    -seg->end_pos.y);
+			glVertex3f(seg->end_pos.x, h, -seg->end_pos.y);
 			x = vect2_add(seg->end_pos, vect2_scmul(dir_v,
 			    ORIENTATION_LINE_LEN));
-			glVertex3f(x.x, info.locationY, -x.y);
+			glVertex3f(x.x, h, -x.y);
 			glEnd();
 		}
 		if (seg->type == SEG_TYPE_TURN || seg->backward) {
 			glBegin(GL_LINES);
 			glColor3f(1, 0, 0);
-			glVertex3f(seg->end_pos.x, info.locationY,
-			    -seg->end_pos.y);
+			glVertex3f(seg->end_pos.x, h, -seg->end_pos.y);
 			x = vect2_add(seg->end_pos, vect2_neg(vect2_scmul(
 			    dir_v, ORIENTATION_LINE_LEN)));
-			glVertex3f(x.x, info.locationY, -x.y);
+			glVertex3f(x.x, h, -x.y);
 			glEnd();
 		}
-		draw_acf_symbol(VECT3(seg->end_pos.x, info.locationY,
-		    seg->end_pos.y), seg->end_hdg, bp.veh.wheelbase,
-		    AMBER_TUPLE);
-	} else {
-		VERIFY3U(XPLMProbeTerrainXYZ(probe, cursor_world_pos.x, 0,
-		    -cursor_world_pos.y, &info), ==, xplm_ProbeHitTerrain);
-		draw_acf_symbol(VECT3(cursor_world_pos.x, info.locationY,
-		    cursor_world_pos.y), cursor_hdg, bp.veh.wheelbase,
-		    RED_TUPLE);
+		draw_acf_symbol(VECT3(seg->end_pos.x, h, seg->end_pos.y),
+		    seg->end_hdg, AMBER_TUPLE);
+	} else if (!view_only) {
+		h = terr_cache_height(cursor_world_pos);
+		draw_acf_symbol(VECT3(cursor_world_pos.x, h,
+		    cursor_world_pos.y), cursor_hdg, RED_TUPLE);
 	}
 
 	if ((seg = list_tail(&bp.segs)) != NULL) {
-		VERIFY3U(XPLMProbeTerrainXYZ(probe, seg->end_pos.x, 0,
-		    -seg->end_pos.y, &info), ==, xplm_ProbeHitTerrain);
-		draw_acf_symbol(VECT3(seg->end_pos.x, info.locationY,
-		    seg->end_pos.y), seg->end_hdg, bp.veh.wheelbase,
-		    GREEN_TUPLE);
+		h = terr_cache_height(seg->end_pos);
+		draw_acf_symbol(VECT3(seg->end_pos.x, h, seg->end_pos.y),
+		    seg->end_hdg, GREEN_TUPLE);
 	}
 
 	/* Draw the night-lighting lamp so the user can see under the cursor */
-	VERIFY3U(XPLMProbeTerrainXYZ(probe, cursor_world_pos.x, 0,
-	    -cursor_world_pos.y, &info), ==, xplm_ProbeHitTerrain);
 	di.structSize = sizeof (di);
 	di.x = cursor_world_pos.x;
-	di.y = info.locationY;
+	di.y = terr_cache_height(cursor_world_pos);
 	di.z = -cursor_world_pos.y;
 	di.heading = 0;
 	di.pitch = 0;
@@ -739,8 +664,6 @@ draw_prediction(XPLMDrawingPhase phase, int before, void *refcon)
 	ASSERT(cam_lamp_inst != NULL);
 	XPLMInstanceSetPosition(cam_lamp_inst, &di, NULL);
 
-	XPLMDestroyProbe(probe);
-
 	glMatrixMode(GL_MODELVIEW);
 	glPopMatrix();
 	glMatrixMode(GL_PROJECTION);
@@ -753,15 +676,19 @@ void
 draw_icon(button_t *btn, int x, int y, double scale, bool_t is_clicked,
     bool_t is_lit)
 {
-	glBindTexture(GL_TEXTURE_2D, btn->tex);
+	/*
+	 * All icons live in the same atlas texture, so XPLMBindTexture2d
+	 * turns all but the first bind in a frame into a no-op.
+	 */
+	XPLMBindTexture2d(btn->tex, 0);
 	glBegin(GL_QUADS);
-	glTexCoord2f(0, 1);
+	glTexCoord2f(btn->s0, btn->t1);
 	glVertex2f(x, y);
-	glTexCoord2f(0, 0);
+	glTexCoord2f(btn->s0, btn->t0);
 	glVertex2f(x, y + btn->h * scale);
-	glTexCoord2f(1, 0);
+	glTexCoord2f(btn->s1, btn->t0);
 	glVertex2f(x + btn->w * scale, y + btn->h * scale);
-	glTexCoord2f(1, 1);
+	glTexCoord2f(btn->s1, btn->t1);
 	glVertex2f(x + btn->w * scale, y);
 	glEnd();
 
@@ -797,6 +724,18 @@ draw_icon(button_t *btn, int x, int y, double scale, bool_t is_clicked,
 	}
 }
 
+/*
+ * In view-only mode, only the buttons to move the view and to close the
+ * planner are shown.
+ */
+static bool_t
+button_shown(int i)
+{
+	return (!view_only || buttons[i].vk == XPLM_VK_RETURN ||
+	    buttons[i].vk == XPLM_VK_ESCAPE ||
+	    strcmp(buttons[i].filename, "move_view.png") == 0);
+}
+
 static void
 fake_win_draw(XPLMWindowID inWindowID, void *inRefcon)
 {
@@ -830,7 +769,7 @@ fake_win_draw(XPLMWindowID inWindowID, void *inRefcon)
 	    i++, h_off -= buttons[i].h * scale) {
 		button_t *btn = &buttons[i];
 
-		if (btn->tex == 0)
+		if (btn->tex == 0 || !button_shown(i))
 			continue;
 
 		draw_icon(btn, w - btn->w * scale, h_off - btn->h * scale,
@@ -860,7 +799,7 @@ button_hit_check(int x, int y)
 	    i++, h_off -= buttons[i].h * scale) {
 		if (x >= w - buttons[i].w * scale && x <= w &&
 		    y >= h_off - buttons[i].h * scale && y <= h_off &&
-		    buttons[i].vk != -1)
+		    buttons[i].vk != -1 && button_shown(i))
 			return (i);
 	}
 
@@ -1021,12 +960,15 @@ key_sniffer(char inChar, XPLMKeyFlags inFlags, char inVirtualKey, void *refcon)
 		XPLMCommandOnce(XPLMFindCommand("BetterPushback/stop_planner"));
 		return (0);
 	case XPLM_VK_ESCAPE:
-		bp_delete_all_segs();
+		if (!view_only)
+			bp_delete_all_segs();
 		XPLMCommandOnce(XPLMFindCommand("BetterPushback/stop_planner"));
 		return (0);
 	case XPLM_VK_CLEAR:
 	case XPLM_VK_BACK:
 	case XPLM_VK_DELETE:
+		if (view_only)
+			return (1);
 		/* Delete the segments up to the next user-placed segment */
 		free(list_remove_tail(&bp.segs));
 		for (seg_t *seg = list_tail(&bp.segs); seg != NULL &&
@@ -1036,6 +978,8 @@ key_sniffer(char inChar, XPLMKeyFlags inFlags, char inVirtualKey, void *refcon)
 		}
 		return (0);
 	case XPLM_VK_SPACE:
+		if (view_only)
+			return (1);
 		bp_delete_all_segs();
 		XPLMCommandOnce(XPLMFindCommand(
 		    "BetterPushback/connect_first"));
@@ -1098,6 +1042,11 @@ bp_cam_start(void)
 		return (B_FALSE);
 
 	find_drs();
+	/*
+	 * On the slave, the planner only shows the master's route, which
+	 * bp_run mirrors into bp.segs while the pushback is running.
+	 */
+	view_only = slave_mode;
 
 	cam_obj_path = mkpathname(bp_xpdir, bp_plugindir, "objects",
 	    "night_lamp.obj", NULL);
@@ -1116,11 +1065,19 @@ bp_cam_start(void)
 		return (B_FALSE);
 	}
 
+	/*
+	 * If the nearest airport isn't known yet, draw_prediction loads
+	 * its overlay once it is.
+	 */
+	arpt_overlay_pending = !nearest_airport_ready();
 	(void) find_nearest_airport(icao);
+	arpt_overlay_load(icao);
 	if (acf_is_airliner())
 		read_acf_airline(airline);
-	if (!tug_available(dr_getf(&drs.mtow), bp.acf.nw_len, bp.acf.tirrad,
-	    bp.acf.nw_type, strcmp(icao, "") != 0 ? icao : NULL, airline)) {
+	/* the slave uses whichever tug the master picks */
+	if (!view_only && !tug_available(dr_getf(&drs.mtow), bp.acf.nw_len,
+	    bp.acf.tirrad, bp.acf.nw_type, strcmp(icao, "") != 0 ? icao : NULL,
+	    airline)) {
 		XPLMSpeakString(_("Pushback failure: no suitable tug for your "
 		    "aircraft."));
 		return (B_FALSE);
@@ -1133,13 +1090,16 @@ bp_cam_start(void)
 		    "stationary."));
 		return (B_FALSE);
 	}
-	if (bp_started && !late_plan_requested) {
+	if (bp_started && !late_plan_requested && !view_only) {
 		XPLMSpeakString(_("Can't start planner: pushback already in "
 		    "progress. Please stop the pushback operation first."));
 		return (B_FALSE);
 	}
 #endif	/* !PB_DEBUG_INTF */
 
+	if (!pred_svc_init())
+		return (B_FALSE);
+
 	XPLMGetScreenSize(&fake_win_ops.right, &fake_win_ops.top);
 
 	circle_view_cmd = XPLMFindCommand("sim/view/circle");
@@ -1152,6 +1112,8 @@ bp_cam_start(void)
 	XPLMTakeKeyboardFocus(fake_win);
 
 	list_create(&pred_segs, sizeof (seg_t), offsetof(seg_t, node));
+	pred_input_valid = B_FALSE;
+	unproj.valid = B_FALSE;
 	force_root_win_focus = B_TRUE;
 	cam_height = 15 * bp.veh.wheelbase;
 	/* We keep the camera position in our coordinates for ease of manip */
@@ -1174,7 +1136,7 @@ bp_cam_start(void)
 	XPLMRegisterKeySniffer(key_sniffer, 1, NULL);
 
 	/* If the list of segs is empty, try to reload the saved state */
-	if (list_head(&bp.segs) == NULL) {
+	if (list_head(&bp.segs) == NULL && !view_only) {
 		route_load(GEO_POS2(dr_getf(&drs.lat), dr_getf(&drs.lon)),
 		    dr_getf(&drs.hdg), &bp.segs);
 	}
@@ -1217,9 +1179,12 @@ bp_cam_stop(void)
 		XPLMUnloadObject(cam_lamp_obj);
 	cam_lamp_obj = NULL;
 
+	pred_svc_fini();
 	while ((seg = list_remove_head(&pred_segs)) != NULL)
 		free(seg);
 	list_destroy(&pred_segs);
+	route_vbo_fini(&route_rv);
+	route_vbo_fini(&pred_rv);
 
 	XPLMUnregisterDrawCallback(draw_prediction, PREDICTION_DRAWING_PHASE,
 	    PREDICTION_DRAWING_PHASE_BEFORE, NULL);
@@ -33,8 +33,8 @@ extern "C" {
 typedef struct {
 	const char	*filename;	/* PNG filename in data/icons/<lang> */
 	const int	vk;		/* function virtual key, -1 if none */
-	GLuint		tex;		/* OpenGL texture object */
-	GLbyte		*tex_data;	/* RGBA texture data */
+	GLuint		tex;		/* icon atlas texture object */
+	GLfloat		s0, t0, s1, t1;	/* icon texture coords in the atlas */
 	int		w, h;		/* button width & height in pixels */
 } button_t;
 
@@ -55,12 +55,11 @@ typedef struct {
 bool_t bp_cam_start(void);
 bool_t bp_cam_stop(void);
 bool_t bp_cam_is_running(void);
+void bp_cam_acf_sym_flush(void);
 
 void draw_icon(button_t *btn, int x, int y, double scale,
     bool_t is_clicked, bool_t is_lit);
-bool_t load_icon(button_t *btn);
-void unload_icon(button_t *btn);
-bool_t load_buttons(void);
+bool_t load_buttons(button_t *extra, size_t n_extra);
 void unload_buttons(void);
 void nil_win_key(XPLMWindowID inWindowID, char inKey, XPLMKeyFlags inFlags,
     char inVirtualKey, void *inRefcon, int losingFocus);
@@ -16,6 +16,7 @@
  * Copyright 2017 Saso Kiselkov. All rights reserved.
  */
 
+#include <math.h>
 #include <string.h>
 
 #include <XPLMCamera.h>
@@ -27,13 +28,13 @@
 
 #include <acfutils/assert.h>
 #include <acfutils/dr.h>
-#include <acfutils/intl.h>
 #include <acfutils/widget.h>
 #include <acfutils/time.h>
 
 #include "bp.h"
 #include "bp_cam.h"
 #include "cab_view.h"
+#include "xlate_cat.h"
 #include "xplane.h"
 
 #define	INCR_SMALL	0.005
@@ -49,8 +50,33 @@
 #define	HINTBAR_HEIGHT	20
 #define	HINTBAR_TIMEOUT	SEC2USEC(5)
 
+#define	MAX_EXTRAP_T	SEC2USEC(0.1)	/* max extrapolation interval, usec */
+
 static bool_t started = B_FALSE;
 
+/*
+ * The tug's pose only changes in the flight loop, but the camera callback
+ * runs at render rate. So to keep the view from juddering when the two
+ * rates differ, we remember the last two distinct tug poses along with
+ * the time we first saw them and extrapolate from those to the time of
+ * the frame being rendered.
+ *
+ * The terrain under the tug is only probed once for every new pose,
+ * using our persistent probe. The result is kept with the pose and for
+ * the extrapolated positions we simply follow the terrain's tangent
+ * plane at the last pose, so rendering costs no probes at all.
+ */
+typedef struct {
+	vehicle_pos_t	pos;
+	uint64_t	t;	/* microclock() when first seen */
+	double		elev;	/* terrain elevation, OpenGL Y coord */
+	vect3_t		norm;	/* terrain normal, OpenGL coords */
+} tug_state_t;
+
+static XPLMProbeRef	probe = NULL;
+static tug_state_t	states[2];	/* [0] = previous, [1] = latest */
+static unsigned		n_states = 0;
+
 /*
  * The delta to the tug's nominal camera position.
  * d_orient is the delta in X (heading) and Y (pitch).
@@ -134,12 +160,76 @@ cab_view_can_start(void)
 	return (!started && bp_started && bp_ls.tug != NULL);
 }
 
+/*
+ * Records the tug's current pose if it differs from the last one we've
+ * seen, probing the terrain underneath it.
+ */
+static void
+tug_state_update(uint64_t now)
+{
+	const vehicle_pos_t *tp = &bp_ls.tug->pos;
+	tug_state_t *st;
+	XPLMProbeInfo_t info = { .structSize = sizeof (XPLMProbeInfo_t) };
+
+	if (n_states != 0 && tp->pos.x == states[1].pos.pos.x &&
+	    tp->pos.y == states[1].pos.pos.y && tp->hdg == states[1].pos.hdg)
+		return;
+
+	states[0] = states[1];
+	n_states = MIN(n_states + 1, 2);
+	st = &states[1];
+	st->pos = *tp;
+	st->t = now;
+
+	VERIFY3U(XPLMProbeTerrainXYZ(probe, tp->pos.x, 0, -tp->pos.y, &info),
+	    ==, xplm_ProbeHitTerrain);
+	/* Must be upright, no driving on ceilings! */
+	ASSERT3F(info.normalY, >, 0.0);
+	st->elev = info.locationY;
+	st->norm = VECT3(info.normalX, info.normalY, info.normalZ);
+}
+
+/*
+ * Extrapolates the tug's pose from its last two states to `now' and
+ * returns it. The returned pos.spd field is meaningless. `elev' is
+ * filled with the terrain elevation at the extrapolated position.
+ */
+static vehicle_pos_t
+tug_state_extrap(uint64_t now, double *elev)
+{
+	const tug_state_t *prev = &states[0], *cur = &states[1];
+	vehicle_pos_t res = cur->pos;
+	vect2_t d_pos;
+	double d_t, f;
+
+	*elev = cur->elev;
+	/*
+	 * Don't extrapolate a stationary tug, or past one interval between
+	 * states (so a stopping tug doesn't drift on).
+	 */
+	if (n_states < 2 || cur->pos.spd == 0 || cur->t <= prev->t)
+		return (res);
+	d_t = MIN(MIN(now - cur->t, cur->t - prev->t), MAX_EXTRAP_T);
+	f = d_t / (double)(cur->t - prev->t);
+
+	d_pos = vect2_scmul(vect2_sub(cur->pos.pos, prev->pos.pos), f);
+	res.pos = vect2_add(cur->pos.pos, d_pos);
+	res.hdg = normalize_hdg(cur->pos.hdg +
+	    rel_hdg(prev->pos.hdg, cur->pos.hdg) * f);
+	/* follow the terrain's tangent plane, our Y axis is X-Plane's -Z */
+	*elev += (-cur->norm.x * d_pos.x + cur->norm.z * d_pos.y) /
+	    cur->norm.y;
+
+	return (res);
+}
+
 static int
 cam_ctl(XPLMCameraPosition_t *pos, int losing_control, void *refcon)
 {
-	XPLMProbeRef probe;
-	XPLMProbeInfo_t info = { .structSize = sizeof (XPLMProbeInfo_t) };
-	vect3_t tug_pos, norm, cam_pos, norm_hdg;
+	uint64_t now = microclock();
+	vehicle_pos_t tp;
+	double elev;
+	vect3_t tug_pos, cam_pos, norm_hdg;
 
 	UNUSED(refcon);
 
@@ -148,36 +238,26 @@ cam_ctl(XPLMCameraPosition_t *pos, int losing_control, void *refcon)
 		return (0);
 	}
 
-	probe = XPLMCreateProbe(xplm_ProbeY);
-	VERIFY3U(XPLMProbeTerrainXYZ(probe, bp_ls.tug->pos.pos.x, 0,
-	    -bp_ls.tug->pos.pos.y, &info), ==, xplm_ProbeHitTerrain);
-	/* Must be upright, no driving on ceilings! */
-	ASSERT3F(info.normalY, >, 0.0);
-
-	norm = VECT3(info.normalX, info.normalY, info.normalZ);
-	tug_pos = VECT3(bp_ls.tug->pos.pos.x, info.locationY,
-	    bp_ls.tug->pos.pos.y);
+	tug_state_update(now);
+	tp = tug_state_extrap(now, &elev);
+	tug_pos = VECT3(tp.pos.x, elev, tp.pos.y);
 
 	cam_pos = vect3_add(bp_ls.tug->info->cam_pos, d_pos);
 	cam_pos.y += bp_ls.tug->info->cab_lift_h * dr_getf(&cab_pos_dr);
-	cam_pos = vect3_rot(cam_pos, -bp_ls.tug->pos.hdg, 1);
+	cam_pos = vect3_rot(cam_pos, -tp.hdg, 1);
 	cam_pos = vect3_add(cam_pos, tug_pos);
 
-	norm_hdg = vect3_rot(VECT3(info.normalX, info.normalY, -info.normalZ),
-	    bp_ls.tug->pos.hdg, 1);
-	UNUSED(norm_hdg);
-	UNUSED(norm);
+	norm_hdg = vect3_rot(VECT3(states[1].norm.x, states[1].norm.y,
+	    -states[1].norm.z), tp.hdg, 1);
 
 	pos->x = cam_pos.x;
 	pos->y = cam_pos.y;
 	pos->z = -cam_pos.z;
-	pos->heading = bp_ls.tug->pos.hdg + d_orient.x;
+	pos->heading = tp.hdg + d_orient.x;
 	pos->pitch = -RAD2DEG(atan(norm_hdg.z / norm_hdg.y)) + d_orient.y;
 	pos->roll = RAD2DEG(atan(norm_hdg.x / norm_hdg.y));
 	pos->zoom = zoom;
 
-	XPLMDestroyProbe(probe);
-
 	return (1);
 }
 
@@ -299,6 +379,9 @@ cab_view_start(void)
 	 */
 	XPLMCommandOnce(XPLMFindCommand("sim/view/circle"));
 
+	if (probe == NULL)
+		probe = XPLMCreateProbe(xplm_ProbeY);
+	n_states = 0;
 	XPLMControlCamera(xplm_ControlCameraUntilViewChanges, cam_ctl, NULL);
 	started = B_TRUE;
 
@@ -377,6 +460,10 @@ cab_view_stop(void)
 			view_cmds[i].cmd = NULL;
 		}
 	}
+	if (probe != NULL) {
+		XPLMDestroyProbe(probe);
+		probe = NULL;
+	}
 
 	started = B_FALSE;
 }
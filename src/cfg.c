@@ -25,12 +25,12 @@
 
 #include <acfutils/assert.h>
 #include <acfutils/helpers.h>
-#include <acfutils/intl.h>
 #include <acfutils/wav.h>
 #include <acfutils/widget.h>
 
 #include "cfg.h"
 #include "msg.h"
+#include "xlate_cat.h"
 #include "xplane.h"
 
 #define	CONF_FILENAME	"BetterPushback.cfg"
@@ -41,6 +41,15 @@ conf_t *bp_conf = NULL;
 static bool_t inited = B_FALSE;
 static XPWidgetID main_win = NULL;
 
+/* The settings currently in effect, see bp_conf_changes */
+static struct {
+	char	*lang;
+	char	*radio_dev;
+	char	*sound_dev;
+	bool_t	shared_ctx;
+	bool_t	dont_hide_xp11_tug;
+} applied;
+
 #define	MARGIN			30
 
 #define	BUTTON_HEIGHT		22
@@ -186,7 +195,7 @@ main_window_cb(XPWidgetMessage msg, XPWidgetID widget, intptr_t param1,
 	} else if (msg == xpMsg_PushButtonPressed) {
 		if (btn == buttons.save_cfg && !bp_started) {
 			(void) bp_conf_save();
-			bp_sched_reload();
+			bp_sched_conf_apply();
 		}
 		return (0);
 	} else if (msg == xpMsg_ButtonStateChanged) {
@@ -472,6 +481,36 @@ destroy_main_window(void)
 	main_win = NULL;
 }
 
+static char *
+conf_strdup(const char *key)
+{
+	const char *val = "";
+
+	(void) conf_get_str(bp_conf, key, &val);
+	return (strdup(val));
+}
+
+static void
+applied_free(void)
+{
+	free(applied.lang);
+	free(applied.radio_dev);
+	free(applied.sound_dev);
+	memset(&applied, 0, sizeof (applied));
+}
+
+static void
+applied_snapshot(void)
+{
+	applied_free();
+	applied.lang = conf_strdup("lang");
+	applied.radio_dev = conf_strdup("radio_device");
+	applied.sound_dev = conf_strdup("sound_device");
+	(void) conf_get_b(bp_conf, "shared_ctx", &applied.shared_ctx);
+	(void) conf_get_b(bp_conf, "dont_hide_xp11_tug",
+	    &applied.dont_hide_xp11_tug);
+}
+
 bool_t
 bp_conf_init(void)
 {
@@ -498,6 +537,7 @@ bp_conf_init(void)
 		bp_conf = conf_create_empty();
 	}
 	free(path);
+	applied_snapshot();
 
 	inited = B_TRUE;
 
@@ -549,10 +589,71 @@ bp_conf_fini(void)
 	}
 	conf_free(bp_conf);
 	bp_conf = NULL;
+	applied_free();
 
 	inited = B_FALSE;
 }
 
+/*
+ * Returns a mask of conf_chg_t flags of the settings which have changed
+ * since the previous call (or since bp_conf_init), and marks the current
+ * settings as being in effect.
+ */
+unsigned
+bp_conf_changes(void)
+{
+	unsigned chg = 0;
+	char *lang = applied.lang;
+	char *radio_dev = applied.radio_dev;
+	char *sound_dev = applied.sound_dev;
+	bool_t shared_ctx = applied.shared_ctx;
+	bool_t dont_hide_xp11_tug = applied.dont_hide_xp11_tug;
+
+	ASSERT(inited);
+
+	/* detach the old snapshot, applied_snapshot would free it */
+	memset(&applied, 0, sizeof (applied));
+	applied_snapshot();
+
+	if (strcmp(lang, applied.lang) != 0)
+		chg |= CONF_CHG_LANG;
+	if (strcmp(radio_dev, applied.radio_dev) != 0 ||
+	    shared_ctx != applied.shared_ctx)
+		chg |= CONF_CHG_RADIO_DEV;
+	if (strcmp(sound_dev, applied.sound_dev) != 0 ||
+	    shared_ctx != applied.shared_ctx)
+		chg |= CONF_CHG_SOUND_DEV;
+	if (dont_hide_xp11_tug != applied.dont_hide_xp11_tug)
+		chg |= CONF_CHG_XP11_TUG;
+
+	free(lang);
+	free(radio_dev);
+	free(sound_dev);
+
+	return (chg);
+}
+
+/*
+ * Throws away the preferences window, so that it gets recreated using the
+ * current language next time it's needed. If the window was open, it's
+ * reopened right away.
+ */
+void
+bp_conf_gui_reset(void)
+{
+	bool_t visible;
+
+	ASSERT(inited);
+
+	if (main_win == NULL)
+		return;
+	visible = XPIsWidgetVisible(main_win);
+	destroy_main_window();
+	tooltip_fini();
+	if (visible)
+		bp_conf_open();
+}
+
 static void
 gui_init(void)
 {
@@ -27,10 +27,25 @@ extern "C" {
 
 extern conf_t *bp_conf;
 
+/*
+ * Configuration changes which need to be acted upon, as returned by
+ * bp_conf_changes. Settings not listed here are either read every time
+ * they're used, or are part of the key of whatever caches their effect.
+ */
+typedef enum {
+	CONF_CHG_LANG =		1 << 0,	/* user interface language */
+	CONF_CHG_RADIO_DEV =	1 << 1,	/* voice message output device */
+	CONF_CHG_SOUND_DEV =	1 << 2,	/* tug sound output device */
+	CONF_CHG_XP11_TUG =	1 << 3	/* default X-Plane tug hiding */
+} conf_chg_t;
+
 bool_t bp_conf_init();
 bool_t bp_conf_save();
 void bp_conf_fini();
 
+unsigned bp_conf_changes(void);
+void bp_conf_gui_reset(void);
+
 void bp_conf_set_save_enabled(bool_t flag);
 
 void bp_conf_open(void);
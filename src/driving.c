@@ -35,6 +35,7 @@
 #include <XPLMUtilities.h>
 
 #include "driving.h"
+#include "telemetry.h"
 #include "xplane.h"
 
 #define	SEG_TURN_MULT		0.9	/* leave 10% for oversteer */
@@ -621,6 +622,45 @@ turn_run(const vehicle_pos_t *pos, const vehicle_t *veh, const seg_t *seg,
 	    3, B_TRUE, last_mis_hdg, d_t, out_steer, out_speed);
 }
 
+static void
+drive_telem(const vehicle_pos_t *pos, const vehicle_t *veh,
+    const seg_t *seg, vect2_t fixed_pos, double mis_hdg, double steer,
+    double speed, bool_t decelerating)
+{
+	telem_sample_t *s = telem_begin(TELEM_SRC_DRIVE);
+
+	if (s == NULL)
+		return;
+
+	if (seg->type == SEG_TYPE_STRAIGHT) {
+		vect2_t dir = hdg2dir(seg->start_hdg);
+		s->xtrk = vect2_dotprod(vect2_sub(fixed_pos, seg->start_pos),
+		    vect2_norm(dir, B_TRUE));
+	} else {
+		vect2_t c = vect2_add(vect2_set_abs(vect2_norm(
+		    hdg2dir(seg->start_hdg), seg->turn.right), seg->turn.r),
+		    seg->start_pos);
+		/* outside of the arc is to the left of a right turn */
+		s->xtrk = vect2_dist(fixed_pos, c) - seg->turn.r;
+		if (seg->turn.right)
+			s->xtrk = -s->xtrk;
+	}
+	s->seg_type = seg->type;
+	if (seg->backward)
+		s->flags |= TELEM_FLAG_BACKWARD;
+	if (decelerating)
+		s->flags |= TELEM_FLAG_DECEL;
+	s->x = pos->pos.x;
+	s->y = pos->pos.y;
+	s->hdg = pos->hdg;
+	s->spd = pos->spd;
+	s->cmd_steer = steer;
+	s->cmd_spd = speed;
+	s->hdg_err = mis_hdg;
+	s->wheelbase = veh->wheelbase;
+	telem_commit();
+}
+
 bool_t
 drive_segs(const vehicle_pos_t *pos, const vehicle_t *veh, list_t *segs,
     double *last_mis_hdg, double d_t, double *out_steer, double *out_speed,
@@ -678,6 +718,9 @@ drive_segs(const vehicle_pos_t *pos, const vehicle_t *veh, list_t *segs,
 	/* limit desired steering */
 	*out_steer = STEER_GATE(*out_steer, veh->max_steer);
 
+	drive_telem(pos, veh, seg, fixed_pos, *last_mis_hdg, *out_steer,
+	    *out_speed, out_decelerating != NULL && *out_decelerating);
+
 	return (B_TRUE);
 }
 
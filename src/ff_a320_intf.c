@@ -41,8 +41,26 @@
 
 #include "xplane.h"
 
+/*
+ * The FF A320 can trigger our commands by setting the BetterPushback*
+ * shared values, which are backed directly by the `cmds' fields below.
+ * We don't get notified when that happens, but the A320 calls our
+ * ff_a320_update callback on every one of its updates anyway. So that's
+ * where we check for requests, only scheduling cmd_dispatch (which runs
+ * the actual commands) if there is one. The BetterPushbackCan* values
+ * are likewise only touched when our pushback state changes.
+ */
 static bool_t			inited = B_FALSE;
 static SharedValuesInterface	svi;
+static XPLMFlightLoopID		dispatch_floop = NULL;
+static bool_t			last_started;
+
+static struct {
+	XPLMCommandRef	start;
+	XPLMCommandRef	stop;
+	XPLMCommandRef	start_planner;
+	XPLMCommandRef	cab_camera;
+} cmd_refs;
 
 static struct {
 	bool_t		inited;
@@ -77,12 +95,28 @@ static const char *type2str(unsigned int t);
 static float cmd_dispatch(float elapsed, float elapsed2, int counter,
     void *refcon);
 
+static void
+can_update(void)
+{
+	cmds.can_start = !bp_started;
+	cmds.can_stop = bp_started;
+	cmds.can_start_planner = !bp_started;
+	cmds.can_cab_camera = bp_started;
+	last_started = bp_started;
+}
+
 bool_t
 ff_a320_intf_init(void)
 {
 	XPLMPluginID plugin;
 	char author[64];
 	dr_t author_dr;
+	XPLMCreateFlightLoop_t floop = {
+	    .structSize = sizeof (floop),
+	    .phase = xplm_FlightLoop_Phase_BeforeFlightModel,
+	    .callbackFunc = cmd_dispatch,
+	    .refcon = NULL
+	};
 
 	/*
 	 * For some reason X-Plane 10 can send us the PLANE_LOADED message
@@ -106,11 +140,20 @@ ff_a320_intf_init(void)
 		return (B_FALSE);
 	}
 
-	svi.DataAddUpdate((SharedDataUpdateProc)ff_a320_update, NULL);
-	XPLMRegisterFlightLoopCallback(cmd_dispatch, -1, NULL);
+	cmd_refs.start = XPLMFindCommand("BetterPushback/start");
+	cmd_refs.stop = XPLMFindCommand("BetterPushback/stop");
+	cmd_refs.start_planner = XPLMFindCommand(
+	    "BetterPushback/start_planner");
+	cmd_refs.cab_camera = XPLMFindCommand("BetterPushback/cab_camera");
+	VERIFY(cmd_refs.start != NULL && cmd_refs.stop != NULL &&
+	    cmd_refs.start_planner != NULL && cmd_refs.cab_camera != NULL);
 
 	memset(&ids, 0, sizeof (ids));
 	memset(&cmds, 0, sizeof (cmds));
+	can_update();
+
+	dispatch_floop = XPLMCreateFlightLoop(&floop);
+	svi.DataAddUpdate((SharedDataUpdateProc)ff_a320_update, NULL);
 
 	inited = B_TRUE;
 
@@ -123,9 +166,10 @@ ff_a320_intf_fini(void)
 	if (!inited)
 		return;
 
-	XPLMUnregisterFlightLoopCallback(cmd_dispatch, NULL);
 	if (svi.DataDelUpdate != NULL)
 		svi.DataDelUpdate((SharedDataUpdateProc)ff_a320_update, NULL);
+	XPLMDestroyFlightLoop(dispatch_floop);
+	dispatch_floop = NULL;
 
 	inited = B_FALSE;
 }
@@ -291,6 +335,11 @@ ff_a320_update(double step, void *tag)
 	VERIFY(svi.ValueName != NULL);
 
 	ff_a320_ids_init();
+
+	if (bp_started != last_started)
+		can_update();
+	if (cmds.start || cmds.stop || cmds.start_planner || cmds.cab_camera)
+		XPLMScheduleFlightLoop(dispatch_floop, -1, 1);
 }
 
 static float
@@ -302,29 +351,24 @@ cmd_dispatch(float elapsed, float elapsed2, int counter, void *refcon)
 	UNUSED(refcon);
 
 	if (cmds.start) {
-		XPLMCommandOnce(XPLMFindCommand("BetterPushback/start"));
+		XPLMCommandOnce(cmd_refs.start);
 		cmds.start = B_FALSE;
 	}
-	cmds.can_start = !bp_started;
-
 	if (cmds.stop) {
-		XPLMCommandOnce(XPLMFindCommand("BetterPushback/stop"));
+		XPLMCommandOnce(cmd_refs.stop);
 		cmds.stop = B_FALSE;
 	}
-	cmds.can_stop = bp_started;
-
 	if (cmds.start_planner) {
-		XPLMCommandOnce(XPLMFindCommand(
-		    "BetterPushback/start_planner"));
+		XPLMCommandOnce(cmd_refs.start_planner);
 		cmds.start_planner = B_FALSE;
 	}
-	cmds.can_start_planner = !bp_started;
-
 	if (cmds.cab_camera) {
-		XPLMCommandOnce(XPLMFindCommand("BetterPushback/cab_camera"));
+		XPLMCommandOnce(cmd_refs.cab_camera);
 		cmds.cab_camera = B_FALSE;
 	}
-	cmds.can_cab_camera = bp_started;
+	/* the commands may have changed our state, don't wait for the A320 */
+	if (bp_started != last_started)
+		can_update();
 
-	return (-1);
+	return (0);
 }
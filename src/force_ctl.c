@@ -0,0 +1,216 @@
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+*/
+/*
+ * Copyright 2020 Saso Kiselkov. All rights reserved.
+ */
+
+/*
+ * The control law behind push_at_speed: works out the longitudinal force
+ * the tug should be applying to the aircraft to bring it to a target
+ * speed. The force is built from three parts:
+ *
+ * - a feedforward term: mass * desired acceleration, plus the force
+ *	needed to hold the aircraft on the slope, plus an estimate of the
+ *	rolling resistance, refined from the measured response while
+ *	rolling.
+ * - a breakaway assist, which ramps up only while we're still stuck and
+ *	bleeds off once moving.
+ * - a PI correction on the speed error, with conditional integration
+ *	anti-windup against the force limit.
+ *
+ * The output is slew limited and clamped to FORCE_PER_TON. This module
+ * has no X-Plane dependency, so the same code that drives the tug in the
+ * sim can be run against the ground dynamics model in gnd_model.c (see
+ * gnd_bench.c).
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include <acfutils/assert.h>
+#include <acfutils/geom.h>
+#include <acfutils/math.h>
+#include <acfutils/perf.h>
+
+#include "force_ctl.h"
+
+#define	FORCE_PER_TON		5000	/* max push force per ton, Newtons */
+#define	FORCE_SLEW		2	/* max force change, force_lim/sec */
+#define	FORCE_CTL_KP		0.6	/* speed error to accel gain, 1/s */
+#define	FORCE_CTL_KI		0.2	/* speed error integral gain, 1/s^2 */
+#define	SPD_TAU			1.0	/* speed approach time constant, secs */
+#define	SPD_TAU_DECEL		0.25	/* same as above, when decelerating */
+#define	ROLL_FRIC_INIT		0.01	/* initial rolling resistance coeff */
+#define	ROLL_RES_TAU		2	/* rolling resistance filter, secs */
+#define	SLOPE_TAU		1	/* ground slope filter, secs */
+#define	BREAKAWAY_DECAY_TAU	0.3	/* breakaway assist bleed-off, secs */
+
+/*
+ * First-order low-pass filter: moves `old_val' toward `new_val' with a
+ * time constant of `tau' seconds.
+ */
+static double
+filter_in(double old_val, double new_val, double d_t, double tau)
+{
+	return (old_val + (new_val - old_val) * MIN(d_t / tau, 1));
+}
+
+/*
+ * Sets up the controller for an aircraft of `mass' kg. The rolling
+ * resistance estimate is seeded with a typical value and gets refined
+ * from actual measurements once we start moving.
+ */
+void
+force_ctl_init(force_ctl_t *ctl, double mass)
+{
+	memset(ctl, 0, sizeof (*ctl));
+	ctl->roll_res = ROLL_FRIC_INIT * MASS2GFORCE(mass);
+}
+
+/*
+ * Drops the integral & breakaway terms, for when the force being applied
+ * is cut for reasons outside of the controller (e.g. the pilot braking).
+ * The rolling resistance estimate is kept.
+ */
+void
+force_ctl_reset(force_ctl_t *ctl)
+{
+	ctl->integ = 0;
+	ctl->breakaway = 0;
+}
+
+/*
+ * Returns the most force (in Newtons) we'll ever apply to an aircraft of
+ * `mass' kg. This prevents us from flinging the aircraft across the
+ * tarmac in case some external factor is blocking us (like chocks).
+ */
+double
+force_ctl_max_force(double mass)
+{
+	return (FORCE_PER_TON * (mass / 1000));
+}
+
+/*
+ * Runs the controller for a single step and returns the force to apply.
+ */
+double
+force_ctl_step(force_ctl_t *ctl, const force_ctl_in_t *in)
+{
+	double force_lim = force_ctl_max_force(in->mass);
+	/* it takes up to 1s for us to apply full pushback force */
+	double force_incr = force_lim * in->d_t;
+	double cur_spd = in->cur_spd, d_v, a_des, dir, spd_tau;
+	double F_slope, F_ff, F_pi, force;
+
+	ASSERT3F(in->d_t, >, 0);
+
+	ctl->slope = filter_in(ctl->slope, in->slope, in->d_t, SLOPE_TAU);
+	F_slope = MASS2GFORCE(in->mass) * sin(DEG2RAD(ctl->slope));
+
+	/*
+	 * While rolling freely, back out the rolling resistance from how
+	 * the aircraft responded to the force we applied in the last step.
+	 * This soaks up everything we don't model explicitly (tire drag,
+	 * idle thrust, etc.), so it's only ever an estimate and the PI
+	 * term below corrects whatever remains.
+	 */
+	if (ABS(cur_spd) >= in->breakaway_spd && in->learn_roll_res) {
+		double spd_dir = (cur_spd > 0 ? 1 : -1);
+		double roll_res = spd_dir * (in->last_force - F_slope -
+		    in->mass * in->accel);
+		roll_res = MIN(MAX(roll_res, 0), force_lim);
+		ctl->roll_res = filter_in(ctl->roll_res, roll_res, in->d_t,
+		    ROLL_RES_TAU);
+	}
+
+	/*
+	 * Feedforward: the force needed to achieve the desired acceleration
+	 * toward our target speed, hold us on the slope and overcome rolling
+	 * resistance in the direction we want to be going. When we're on a
+	 * deceleration profile, track it tightly, otherwise approach the
+	 * target speed gently to avoid overshoot.
+	 */
+	d_v = in->targ_spd - cur_spd;
+	spd_tau = (in->decelerating ? SPD_TAU_DECEL : SPD_TAU);
+	a_des = MIN(MAX(d_v / spd_tau, -in->max_accel), in->max_accel);
+	if (in->targ_spd != 0)
+		dir = (in->targ_spd > 0 ? 1 : -1);
+	else if (ABS(cur_spd) >= in->breakaway_spd)
+		dir = (cur_spd > 0 ? 1 : -1);
+	else
+		dir = 0;
+	F_ff = in->mass * a_des + F_slope + dir * ctl->roll_res;
+
+	/*
+	 * Static friction is considerably higher than rolling resistance
+	 * and we have no good way of knowing it up front. So while we want
+	 * to be moving but haven't broken away yet, ramp up an additional
+	 * breakaway force. Once rolling, bleed it off again, handing over
+	 * to the feedforward & PI terms.
+	 */
+	if (ABS(cur_spd) < in->breakaway_spd && dir != 0 && d_v * dir > 0) {
+		ctl->breakaway = MIN(MAX(ctl->breakaway + dir * force_incr,
+		    -force_lim), force_lim);
+	} else {
+		ctl->breakaway = filter_in(ctl->breakaway, 0, in->d_t,
+		    BREAKAWAY_DECAY_TAU);
+	}
+
+	/*
+	 * What the integral term has learned only applies to the direction
+	 * it was built up in, so drop it when we reverse. And once we're
+	 * stopped with nowhere to go, bleed it off, rather than keep pushing
+	 * on a stationary aircraft.
+	 */
+	if (dir == 0) {
+		ctl->integ = filter_in(ctl->integ, 0, in->d_t,
+		    BREAKAWAY_DECAY_TAU);
+	} else {
+		if (dir != ctl->dir)
+			ctl->integ = 0;
+		ctl->dir = dir;
+	}
+
+	/*
+	 * PI correction on the speed error. Anti-windup: don't integrate
+	 * further while the output is saturated against the force limit in
+	 * the direction the error is pushing us, nor while we're still
+	 * stuck (that's what the breakaway assist is for). Also hold off
+	 * while we're still on the acceleration limit: the speed error
+	 * there is intentional and integrating it only causes overshoot.
+	 */
+	F_pi = in->mass * FORCE_CTL_KP * d_v + ctl->integ;
+	force = F_ff + ctl->breakaway + F_pi;
+	if (ABS(cur_spd) >= in->breakaway_spd &&
+	    ABS(a_des) < in->max_accel &&
+	    !(force >= force_lim && d_v > 0) &&
+	    !(force <= -force_lim && d_v < 0)) {
+		ctl->integ += in->mass * FORCE_CTL_KI * d_v * in->d_t;
+		ctl->integ = MIN(MAX(ctl->integ, -force_lim), force_lim);
+	}
+
+	/*
+	 * Limit the rate of change of the applied force to keep the tow
+	 * smooth and to not shock the nose gear.
+	 */
+	force = MIN(MAX(force, in->last_force - FORCE_SLEW * force_incr),
+	    in->last_force + FORCE_SLEW * force_incr);
+
+	/* Don't overstep the force limits for this aircraft */
+	force = MIN(force_lim, force);
+	force = MAX(-force_lim, force);
+
+	return (force);
+}
@@ -0,0 +1,64 @@
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+*/
+/*
+ * Copyright 2020 Saso Kiselkov. All rights reserved.
+ */
+
+#ifndef	_FORCE_CTL_H_
+#define	_FORCE_CTL_H_
+
+#include <acfutils/types.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/*
+ * Inputs to a single step of the force controller. Speeds, forces and
+ * accelerations are signed along the aircraft's longitudinal axis,
+ * positive forward (i.e. pushback speeds are negative).
+ */
+typedef struct {
+	double	mass;		/* aircraft mass, kg */
+	double	targ_spd;	/* target speed, m/s */
+	double	cur_spd;	/* current speed, m/s */
+	double	accel;		/* acceleration over the last step, m/s^2 */
+	double	max_accel;	/* m/s^2 */
+	double	slope;		/* ground slope, degrees, +uphill */
+	double	last_force;	/* force actually applied last step, N */
+	double	breakaway_spd;	/* below this speed we're stuck, m/s */
+	bool_t	decelerating;	/* following a deceleration profile */
+	bool_t	learn_roll_res;	/* `accel' reflects `last_force' */
+	double	d_t;		/* step duration, seconds */
+} force_ctl_in_t;
+
+typedef struct {
+	double	integ;		/* PI integral term, Newtons */
+	double	dir;		/* direction `integ' was built in */
+	double	breakaway;	/* static friction assist, Newtons */
+	double	roll_res;	/* est. rolling resistance, Newtons */
+	double	slope;		/* filtered ground slope, degrees */
+} force_ctl_t;
+
+void force_ctl_init(force_ctl_t *ctl, double mass);
+void force_ctl_reset(force_ctl_t *ctl);
+double force_ctl_max_force(double mass);
+double force_ctl_step(force_ctl_t *ctl, const force_ctl_in_t *in);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _FORCE_CTL_H_ */
@@ -0,0 +1,160 @@
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+*/
+/*
+ * Copyright 2020 Saso Kiselkov. All rights reserved.
+ */
+
+/*
+ * Offline bench for push_at_speed's force controller. Runs the control
+ * law in force_ctl.c against the ground dynamics model in gnd_model.c
+ * for a catalog of aircraft on a few slopes and prints the step response
+ * of a straight pushback at walking speed, followed by a stop:
+ *
+ * - rise: seconds until the speed first gets within SPD_TOL of target
+ * - settle: seconds after which the speed stays within SPD_TOL
+ * - overshoot: peak excursion past the target speed, percent
+ * - stop: seconds from the stop command until the aircraft is stationary
+ * - stop_os: peak speed in the opposite direction while stopping, m/s
+ *
+ * Exits with a non-zero status if any run fails to settle or to stop.
+ * Build with "make gnd_bench" (it's not part of the default target).
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <acfutils/geom.h>
+#include <acfutils/helpers.h>
+#include <acfutils/math.h>
+
+#include "force_ctl.h"
+#include "gnd_model.h"
+
+#define	D_T		(1.0 / 30)	/* seconds, a typical frame */
+#define	PUSH_SPD	-1.11		/* m/s, bp.c's MAX_REV_SPEED */
+#define	PUSH_ACCEL	0.25		/* m/s^2, bp.c's NORMAL_ACCEL */
+#define	PUSH_T		40		/* seconds */
+#define	STOP_T		20		/* seconds */
+#define	SPD_TOL		0.05		/* m/s */
+#define	BREAKAWAY_SPD	0.09		/* m/s, bp.c's XP11 BREAKAWAY_THRESH */
+
+typedef struct {
+	const char	*name;
+	gnd_model_acf_t	acf;
+	double		nw_len;		/* nose gear strut length, meters */
+} bench_acf_t;
+
+/*
+ * Rough figures for typical pushback weights. Longitudinal positions
+ * are relative to an arbitrary reference point, positive aft.
+ */
+static const bench_acf_t acfs[] = {
+    { "CRJ200", { .mass = 21000, .cg_z = -0.4, .nw_z = -11.1,
+	.main_z = 0.6, .roll_fric = 0.015, .breakaway_fric = 0.03,
+	.brake_fric = 0.5 }, 1.5 },
+    { "A320", { .mass = 64000, .cg_z = 0.5, .nw_z = -11.0,
+	.main_z = 1.7, .roll_fric = 0.015, .breakaway_fric = 0.03,
+	.brake_fric = 0.5 }, 2.2 },
+    { "B738", { .mass = 62000, .cg_z = 0, .nw_z = -14.0,
+	.main_z = 1.3, .roll_fric = 0.015, .breakaway_fric = 0.03,
+	.brake_fric = 0.5 }, 2.2 },
+    { "B77W", { .mass = 250000, .cg_z = 0.4, .nw_z = -29.0,
+	.main_z = 2.0, .roll_fric = 0.012, .breakaway_fric = 0.025,
+	.brake_fric = 0.5 }, 2.8 },
+    { "A388", { .mass = 400000, .cg_z = 1.0, .nw_z = -29.0,
+	.main_z = 3.0, .roll_fric = 0.012, .breakaway_fric = 0.025,
+	.brake_fric = 0.5 }, 3.0 }
+};
+
+/* ground slope along the aircraft's axis, degrees, +uphill ahead */
+static const double slopes[] = { 0, 1, -1 };
+
+/*
+ * Steps the controller & model once, just like push_at_speed would
+ * (going straight ahead, so there's no yaw moment).
+ */
+static void
+bench_step(gnd_model_t *model, force_ctl_t *ctl, const bench_acf_t *ba,
+    double targ_spd, bool_t decelerating, double *last_force)
+{
+	force_ctl_in_t in = {
+	    .mass = ba->acf.mass,
+	    .targ_spd = targ_spd,
+	    .cur_spd = model->spd,
+	    .accel = model->accel,
+	    .max_accel = PUSH_ACCEL,
+	    .slope = model->acf.slope,
+	    .last_force = *last_force,
+	    .breakaway_spd = BREAKAWAY_SPD,
+	    .decelerating = decelerating,
+	    .learn_roll_res = model->nw_on_gnd,
+	    .d_t = D_T
+	};
+	double force = force_ctl_step(ctl, &in);
+
+	gnd_model_step(model, -force, 0, force * ba->nw_len, D_T);
+	*last_force = force;
+}
+
+static bool_t
+bench_run(const bench_acf_t *ba, double slope)
+{
+	gnd_model_t model;
+	gnd_model_resp_t resp;
+	force_ctl_t ctl;
+	double last_force = 0, stop_start_t, stop_t = NAN, stop_os = 0;
+
+	gnd_model_init(&model, &ba->acf, ZERO_VECT2, 0);
+	gnd_model_set_slope(&model, slope);
+	force_ctl_init(&ctl, ba->acf.mass);
+	gnd_model_resp_init(&resp, PUSH_SPD, SPD_TOL, 0);
+
+	while (model.t < PUSH_T) {
+		bench_step(&model, &ctl, ba, PUSH_SPD, B_FALSE, &last_force);
+		gnd_model_resp_update(&resp, model.t, model.spd);
+	}
+
+	stop_start_t = model.t;
+	while (model.t < stop_start_t + STOP_T) {
+		bench_step(&model, &ctl, ba, 0, B_TRUE, &last_force);
+		stop_os = MAX(stop_os, model.spd);
+		if (model.spd == 0 && isnan(stop_t))
+			stop_t = model.t - stop_start_t;
+		else if (model.spd != 0)
+			stop_t = NAN;
+	}
+
+	printf("%-8s %6.1f %7.2f %7.2f %9.1f %7.2f %8.3f\n", ba->name,
+	    slope, resp.rise_t, resp.settle_t,
+	    100 * resp.overshoot / fabs(PUSH_SPD), stop_t, stop_os);
+
+	return (!isnan(resp.settle_t) && !isnan(stop_t));
+}
+
+int
+main(void)
+{
+	bool_t ok = B_TRUE;
+
+	printf("%-8s %6s %7s %7s %9s %7s %8s\n", "acf", "slope", "rise",
+	    "settle", "overshoot", "stop", "stop_os");
+	for (size_t i = 0; i < ARRAY_NUM_ELEM(acfs); i++) {
+		for (size_t j = 0; j < ARRAY_NUM_ELEM(slopes); j++)
+			ok &= bench_run(&acfs[i], slopes[j]);
+	}
+
+	return (ok ? EXIT_SUCCESS : EXIT_FAILURE);
+}
@@ -0,0 +1,244 @@
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+*/
+/*
+ * Copyright 2020 Saso Kiselkov. All rights reserved.
+ */
+
+/*
+ * This is a simple rigid-body model of an aircraft rolling on its landing
+ * gear. It has no dependency on X-Plane, so gnd_bench.c links it with
+ * push_at_speed's force controller (force_ctl.c) to exercise it over a
+ * catalog of aircraft without having to run the sim.
+ *
+ * The model consumes the same three force plugs that push_at_speed writes
+ * to in the sim:
+ *
+ * - axial_force: longitudinal force in Newtons, positive pointing aft
+ *	(same sense as sim/flightmodel/forces/faxil_plug_acf).
+ * - rot_force_N: yaw moment in N.m about the CG, positive nose right.
+ * - rot_force_M: pitch moment in N.m, positive nose up.
+ *
+ * Longitudinal motion is fully dynamic: the applied force fights against
+ * the slope, rolling friction, main gear braking and, while stopped, the
+ * breakaway (static) friction. Lateral motion is kinematic: the main gear
+ * cannot slip sideways and the nose gear follows the direction of the
+ * force applied to it by the tug (which is what the tug's tow bar or
+ * cradle physically enforces). This is the same bicycle model that the
+ * steering algorithm in driving.c assumes.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include <acfutils/assert.h>
+#include <acfutils/geom.h>
+#include <acfutils/math.h>
+#include <acfutils/perf.h>
+
+#include "gnd_model.h"
+
+#define	MIN_WHEELBASE		0.5	/* meters */
+#define	MIN_STEER_FORCE		1	/* Newtons, below this keep last steer */
+#define	MAX_STEER		89	/* degrees */
+
+static double
+wheelbase(const gnd_model_t *model)
+{
+	return (MAX(model->acf.main_z - model->acf.nw_z, MIN_WHEELBASE));
+}
+
+void
+gnd_model_init(gnd_model_t *model, const gnd_model_acf_t *acf, vect2_t pos,
+    double hdg)
+{
+	ASSERT(model != NULL);
+	ASSERT(acf != NULL);
+	ASSERT3F(acf->mass, >, 0);
+	ASSERT3F(acf->nw_z, <, acf->main_z);
+
+	memset(model, 0, sizeof (*model));
+	model->acf = *acf;
+	model->pos = pos;
+	model->hdg = normalize_hdg(hdg);
+	model->nw_on_gnd = B_TRUE;
+}
+
+void
+gnd_model_set_brake(gnd_model_t *model, double brake)
+{
+	model->brake = MIN(MAX(brake, 0), 1);
+}
+
+void
+gnd_model_set_slope(gnd_model_t *model, double slope)
+{
+	ASSERT3F(fabs(slope), <, 90);
+	model->acf.slope = slope;
+}
+
+/*
+ * Returns the magnitude of the rolling resistance force (Newtons) that
+ * the aircraft is experiencing at the current slope, not counting brakes.
+ */
+double
+gnd_model_roll_force(const gnd_model_t *model)
+{
+	return (model->acf.roll_fric * MASS2GFORCE(model->acf.mass) *
+	    cos(DEG2RAD(model->acf.slope)));
+}
+
+/*
+ * Advances the model by `d_t' seconds, applying the passed force plug
+ * values for the duration of the step.
+ */
+void
+gnd_model_step(gnd_model_t *model, double axial_force, double rot_force_N,
+    double rot_force_M, double d_t)
+{
+	const gnd_model_acf_t *acf = &model->acf;
+	double wb = wheelbase(model);
+	double weight = MASS2GFORCE(acf->mass);
+	double normal = weight * cos(DEG2RAD(acf->slope));
+	double F_long = -axial_force;
+	double F_grav = -weight * sin(DEG2RAD(acf->slope));
+	double F_drive = F_long + F_grav;
+	double F_lat, main_load, F_brake, F_roll, accel;
+	double nw_arm = acf->cg_z - acf->nw_z;
+
+	ASSERT3F(d_t, >, 0);
+
+	/*
+	 * Split the normal load between the nose and main gear by the CG
+	 * position, then shift it according to the pitch moment (taken
+	 * about the main gear contact point). A nose-up moment unloads the
+	 * nose gear and once its load drops to zero, it lifts off.
+	 */
+	model->nw_load = normal * ((acf->main_z - acf->cg_z) / wb) -
+	    rot_force_M / wb;
+	model->nw_on_gnd = (model->nw_load > 0);
+	model->nw_load = MAX(model->nw_load, 0);
+	main_load = MAX(normal - model->nw_load, 0);
+
+	F_roll = acf->roll_fric * normal;
+	F_brake = model->brake * acf->brake_fric * main_load;
+
+	/*
+	 * Back out the lateral force at the nose gear from the yaw moment.
+	 * The tug pushes the nose gear in the direction of its applied
+	 * force, so that's the effective steering angle. With no force
+	 * being applied, the nose gear simply keeps tracking its last
+	 * direction.
+	 */
+	if (nw_arm > 0)
+		F_lat = rot_force_N / nw_arm;
+	else
+		F_lat = 0;
+	if (fabs(F_long) >= MIN_STEER_FORCE) {
+		model->steer = MIN(MAX(RAD2DEG(atan(F_lat / F_long)),
+		    -MAX_STEER), MAX_STEER);
+	}
+
+	if (!model->broken_away) {
+		/*
+		 * Stationary. Static friction and brakes hold us in place
+		 * until the net driving force exceeds them.
+		 */
+		double F_hold = acf->breakaway_fric * normal + F_brake;
+
+		if (fabs(F_drive) <= F_hold) {
+			model->spd = 0;
+			model->accel = 0;
+			model->yaw_rate = 0;
+			model->t += d_t;
+			return;
+		}
+		model->broken_away = B_TRUE;
+		accel = (F_drive - (F_drive > 0 ? 1 : -1) *
+		    (F_roll + F_brake)) / acf->mass;
+	} else {
+		double F_res = F_roll + F_brake;
+		double spd_sign = (model->spd >= 0 ? 1 : -1);
+
+		accel = (F_drive - spd_sign * F_res) / acf->mass;
+		/*
+		 * Friction can only ever bring us to a halt, never reverse
+		 * our direction of travel. If the step would cross zero
+		 * speed and the driving force alone can't overcome the
+		 * static friction, we come to a stop.
+		 */
+		if (model->spd != 0 && (model->spd + accel * d_t) * spd_sign <
+		    0 && fabs(F_drive) <= acf->breakaway_fric * normal +
+		    F_brake) {
+			accel = -model->spd / d_t;
+			model->broken_away = B_FALSE;
+		}
+	}
+
+	model->accel = accel;
+	model->spd += accel * d_t;
+	if (!model->broken_away)
+		model->spd = 0;
+
+	model->yaw_rate = RAD2DEG(model->spd * tan(DEG2RAD(model->steer)) /
+	    wb);
+	model->pos = vect2_add(model->pos, vect2_scmul(hdg2dir(model->hdg),
+	    model->spd * d_t));
+	model->hdg = normalize_hdg(model->hdg + model->yaw_rate * d_t);
+	model->t += d_t;
+}
+
+void
+gnd_model_resp_init(gnd_model_resp_t *resp, double targ_spd, double tol,
+    double start_t)
+{
+	ASSERT3F(tol, >, 0);
+
+	resp->targ_spd = targ_spd;
+	resp->tol = tol;
+	resp->start_t = start_t;
+	resp->init_spd = NAN;
+	resp->overshoot = 0;
+	resp->settle_t = NAN;
+	resp->rise_t = NAN;
+}
+
+/*
+ * Feeds a single speed sample into the response tracker. Samples taken
+ * prior to `start_t' are ignored.
+ */
+void
+gnd_model_resp_update(gnd_model_resp_t *resp, double t, double spd)
+{
+	double dir;
+
+	if (t < resp->start_t)
+		return;
+	if (isnan(resp->init_spd))
+		resp->init_spd = spd;
+
+	dir = (resp->targ_spd >= resp->init_spd ? 1 : -1);
+	resp->overshoot = MAX(resp->overshoot,
+	    (spd - resp->targ_spd) * dir);
+
+	if (fabs(spd - resp->targ_spd) <= resp->tol) {
+		if (isnan(resp->rise_t))
+			resp->rise_t = t - resp->start_t;
+		if (isnan(resp->settle_t))
+			resp->settle_t = t - resp->start_t;
+	} else {
+		/* left the band, so we haven't settled yet */
+		resp->settle_t = NAN;
+	}
+}
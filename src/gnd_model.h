@@ -0,0 +1,95 @@
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+*/
+/*
+ * Copyright 2020 Saso Kiselkov. All rights reserved.
+ */
+
+#ifndef	_GND_MODEL_H_
+#define	_GND_MODEL_H_
+
+#include <acfutils/geom.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/*
+ * Static description of an aircraft for the purposes of the ground
+ * dynamics model. All longitudinal positions are in the aircraft's
+ * coordinate space, i.e. meters along the Z axis, positive aft of the
+ * aircraft's reference point (same as bp.acf.nw_z & bp.acf.main_z).
+ */
+typedef struct {
+	double	mass;		/* total aircraft mass, kg */
+	double	cg_z;		/* CG longitudinal position, meters */
+	double	nw_z;		/* nose gear longitudinal position, meters */
+	double	main_z;		/* main gear longitudinal position, meters */
+	double	roll_fric;	/* rolling friction coefficient, 0..1 */
+	double	breakaway_fric;	/* static (breakaway) friction coeff, 0..1 */
+	double	brake_fric;	/* max main gear braking coefficient, 0..1 */
+	double	slope;		/* ground slope along acf axis, deg, +uphill */
+} gnd_model_acf_t;
+
+/*
+ * Dynamic state of the ground model. The position & heading use the
+ * same conventions as vehicle_pos_t (see driving.h).
+ */
+typedef struct {
+	gnd_model_acf_t	acf;
+	double		steer;		/* effective nose gear angle, degrees */
+	vect2_t		pos;		/* CG position, meters */
+	double		hdg;		/* true heading, degrees */
+	double		spd;		/* longitudinal speed, m/s, neg = aft */
+	double		yaw_rate;	/* deg/s, positive clockwise */
+	double		accel;		/* last longitudinal accel, m/s^2 */
+	double		brake;		/* brake application, 0..1 */
+	double		nw_load;	/* nose gear normal load, Newtons */
+	bool_t		nw_on_gnd;	/* nose gear in contact with ground */
+	bool_t		broken_away;	/* static friction overcome */
+	double		t;		/* simulated time, seconds */
+} gnd_model_t;
+
+/*
+ * Step response tracker. Feed it speed samples from the model and it
+ * records the peak overshoot past the target speed and the time after
+ * which the speed remained within `tol' of the target.
+ */
+typedef struct {
+	double	targ_spd;	/* target speed, m/s */
+	double	tol;		/* settling band half-width, m/s */
+	double	start_t;	/* time of the step command, seconds */
+	double	init_spd;	/* speed at the first sample, m/s */
+	double	overshoot;	/* max excursion past targ_spd, m/s */
+	double	settle_t;	/* settling time since start_t, NAN if never */
+	double	rise_t;		/* time to first enter the band, NAN if never */
+} gnd_model_resp_t;
+
+void gnd_model_init(gnd_model_t *model, const gnd_model_acf_t *acf,
+    vect2_t pos, double hdg);
+void gnd_model_set_brake(gnd_model_t *model, double brake);
+void gnd_model_set_slope(gnd_model_t *model, double slope);
+void gnd_model_step(gnd_model_t *model, double axial_force,
+    double rot_force_N, double rot_force_M, double d_t);
+double gnd_model_roll_force(const gnd_model_t *model);
+
+void gnd_model_resp_init(gnd_model_resp_t *resp, double targ_spd,
+    double tol, double start_t);
+void gnd_model_resp_update(gnd_model_resp_t *resp, double t, double spd);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _GND_MODEL_H_ */
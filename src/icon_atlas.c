@@ -0,0 +1,465 @@
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+*/
+/*
+ * Copyright 2020 Saso Kiselkov. All rights reserved.
+ */
+
+/*
+ * All of the button icons of a given language are packed into a single
+ * texture atlas, one icon below the other. Decoding the PNGs is by far
+ * the most expensive part of this, so once an atlas is built, its raw
+ * RGBA pixels are stored in Output/caches/BetterPushback_icons/<lang>.rgba
+ * and subsequently loaded straight from there, as long as none of the
+ * source PNGs changed. The atlas stays uploaded until icon_atlas_unload
+ * and no copy of the pixels is kept in main memory.
+ *
+ * The cache file format (all integers in native byte order) is:
+ *
+ * atlas_hdr_t				file header
+ * atlas_rec_t * hdr.n_icons		placement of each icon in the atlas
+ * uint8_t * hdr.w * hdr.h * 4		RGBA pixels, top row first
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <png.h>
+
+#include <XPLMGraphics.h>
+
+#include <acfutils/assert.h>
+#include <acfutils/crc64.h>
+#include <acfutils/helpers.h>
+#include <acfutils/log.h>
+
+#include "icon_atlas.h"
+#include "xplane.h"
+
+#define	ICON_DIRS	bp_xpdir, bp_plugindir, "data", "icons"
+#define	ATLAS_DIRS	bp_xpdir, "Output", "caches", "BetterPushback_icons"
+#define	ATLAS_MAGIC	"BPICONS"
+#define	ATLAS_VERSION	1
+#define	ATLAS_PAD	1	/* transparent pixels between icons */
+#define	ICON_BPP	4	/* bytes per pixel, RGBA */
+#define	MAX_ICONS	32
+
+typedef struct {
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	n_icons;
+	uint64_t	key;		/* CRC64 of the source files' stat info */
+	uint32_t	w, h;		/* atlas size in pixels */
+} atlas_hdr_t;
+
+typedef struct {
+	char		filename[64];
+	uint32_t	x, y, w, h;	/* pixels, origin in top left corner */
+} atlas_rec_t;
+
+static struct {
+	char		lang[32];
+	GLuint		tex;
+	button_t	*btns[MAX_ICONS];
+	size_t		n_btns;
+} atlas;
+
+static bool_t
+is_spacer(const button_t *btn)
+{
+	return (strcmp(btn->filename, "") == 0);
+}
+
+/*
+ * Returns the path of an icon's PNG file, preferring the localized version
+ * and falling back to the English one if no localized version exists.
+ */
+static char *
+icon_path(const char *lang, const char *filename)
+{
+	char *path = mkpathname(ICON_DIRS, lang, filename, NULL);
+
+	if (!file_exists(path, NULL)) {
+		free(path);
+		path = mkpathname(ICON_DIRS, "en", filename, NULL);
+	}
+	return (path);
+}
+
+/*
+ * Computes the cache key for a set of icons. This covers the resolved
+ * path, size and modification time of every source PNG, so installing a
+ * new localized icon or updating an existing one invalidates the cache.
+ */
+static bool_t
+atlas_key(const char *lang, button_t *const *btns, size_t n, uint64_t *key)
+{
+	uint64_t crc = 0;
+
+	for (size_t i = 0; i < n; i++) {
+		char *path;
+		struct stat st;
+		int64_t size, mtime;
+
+		if (is_spacer(btns[i]))
+			continue;
+		path = icon_path(lang, btns[i]->filename);
+		if (stat(path, &st) < 0) {
+			logMsg("Cannot stat %s: %s", path, strerror(errno));
+			free(path);
+			return (B_FALSE);
+		}
+		size = st.st_size;
+		mtime = st.st_mtime;
+		crc = crc64_append(crc, path, strlen(path));
+		crc = crc64_append(crc, &size, sizeof (size));
+		crc = crc64_append(crc, &mtime, sizeof (mtime));
+		free(path);
+	}
+	*key = crc;
+
+	return (B_TRUE);
+}
+
+/*
+ * Decodes an 8-bit RGBA PNG file. Returns the pixels (top row first) in a
+ * malloc'd buffer, or NULL on error.
+ */
+static uint8_t *
+png_decode(const char *filename, int *w, int *h)
+{
+	FILE *fp;
+	size_t rowbytes;
+	png_bytep *volatile rowp = NULL;
+	png_structp pngp = NULL;
+	png_infop infop = NULL;
+	uint8_t *volatile pixels = NULL;
+	uint8_t header[8];
+
+	fp = fopen(filename, "rb");
+	if (fp == NULL) {
+		logMsg("Cannot open file %s: %s", filename, strerror(errno));
+		goto out;
+	}
+	if (fread(header, 1, sizeof (header), fp) != 8 ||
+	    png_sig_cmp(header, 0, sizeof (header)) != 0) {
+		logMsg("Cannot open file %s: invalid PNG header", filename);
+		goto out;
+	}
+	pngp = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+	VERIFY(pngp != NULL);
+	infop = png_create_info_struct(pngp);
+	VERIFY(infop != NULL);
+	if (setjmp(png_jmpbuf(pngp))) {
+		logMsg("Cannot open file %s: libpng error in init_io",
+		    filename);
+		goto out;
+	}
+	png_init_io(pngp, fp);
+	png_set_sig_bytes(pngp, 8);
+
+	if (setjmp(png_jmpbuf(pngp))) {
+		logMsg("Cannot open file %s: libpng read info failed",
+		    filename);
+		goto out;
+	}
+	png_read_info(pngp, infop);
+	*w = png_get_image_width(pngp, infop);
+	*h = png_get_image_height(pngp, infop);
+
+	if (png_get_color_type(pngp, infop) != PNG_COLOR_TYPE_RGBA) {
+		logMsg("Bad icon file %s: need color type RGBA", filename);
+		goto out;
+	}
+	if (png_get_bit_depth(pngp, infop) != 8) {
+		logMsg("Bad icon file %s: need 8-bit depth", filename);
+		goto out;
+	}
+	rowbytes = png_get_rowbytes(pngp, infop);
+	VERIFY3U(rowbytes, ==, (size_t)*w * ICON_BPP);
+
+	pixels = malloc(*h * rowbytes);
+	VERIFY(pixels != NULL);
+	rowp = malloc(sizeof (*rowp) * *h);
+	VERIFY(rowp != NULL);
+	for (int i = 0; i < *h; i++)
+		rowp[i] = &pixels[i * rowbytes];
+
+	if (setjmp(png_jmpbuf(pngp))) {
+		logMsg("Bad icon file %s: error reading image file", filename);
+		free(pixels);
+		pixels = NULL;
+		goto out;
+	}
+	png_read_image(pngp, rowp);
+
+out:
+	if (pngp != NULL)
+		png_destroy_read_struct(&pngp, &infop, NULL);
+	free(rowp);
+	if (fp != NULL)
+		fclose(fp);
+
+	return (pixels);
+}
+
+/*
+ * Decodes all the icons and packs them into a new atlas. The atlas is
+ * just wide enough for the widest icon, with the icons stacked on top of
+ * one another, separated by ATLAS_PAD rows of transparent pixels.
+ */
+static uint8_t *
+atlas_build(const char *lang, button_t *const *btns, size_t n,
+    atlas_rec_t *recs, int *atlas_w, int *atlas_h)
+{
+	uint8_t *icons[MAX_ICONS] = { NULL };
+	uint8_t *pixels = NULL;
+	int w = 0, h = 0;
+
+	for (size_t i = 0; i < n; i++) {
+		char *path;
+		int icon_w, icon_h;
+
+		memset(&recs[i], 0, sizeof (recs[i]));
+		strlcpy(recs[i].filename, btns[i]->filename,
+		    sizeof (recs[i].filename));
+		if (is_spacer(btns[i]))
+			continue;
+
+		path = icon_path(lang, btns[i]->filename);
+		icons[i] = png_decode(path, &icon_w, &icon_h);
+		free(path);
+		if (icons[i] == NULL)
+			goto out;
+
+		recs[i].x = 0;
+		recs[i].y = h;
+		recs[i].w = icon_w;
+		recs[i].h = icon_h;
+		w = MAX(w, icon_w);
+		h += icon_h + ATLAS_PAD;
+	}
+
+	pixels = calloc((size_t)w * h, ICON_BPP);
+	VERIFY(pixels != NULL);
+	for (size_t i = 0; i < n; i++) {
+		if (icons[i] == NULL)
+			continue;
+		for (unsigned row = 0; row < recs[i].h; row++) {
+			memcpy(&pixels[((recs[i].y + row) * w + recs[i].x) *
+			    ICON_BPP], &icons[i][row * recs[i].w * ICON_BPP],
+			    recs[i].w * ICON_BPP);
+		}
+	}
+	*atlas_w = w;
+	*atlas_h = h;
+
+out:
+	for (size_t i = 0; i < n; i++)
+		free(icons[i]);
+
+	return (pixels);
+}
+
+static char *
+atlas_cache_path(const char *lang)
+{
+	char filename[64];
+
+	snprintf(filename, sizeof (filename), "%s.rgba", lang);
+	return (mkpathname(ATLAS_DIRS, filename, NULL));
+}
+
+/*
+ * Attempts to load a cached atlas. Returns NULL if no cache exists, if it
+ * is stale (`key' doesn't match), or if it doesn't hold exactly the icons
+ * in `btns' in the same order.
+ */
+static uint8_t *
+atlas_cache_load(const char *lang, uint64_t key, button_t *const *btns,
+    size_t n, atlas_rec_t *recs, int *w, int *h)
+{
+	char *filename = atlas_cache_path(lang);
+	FILE *fp = fopen(filename, "rb");
+	atlas_hdr_t hdr;
+	uint8_t *pixels = NULL;
+	size_t sz;
+
+	if (fp == NULL)
+		goto out;
+	if (fread(&hdr, sizeof (hdr), 1, fp) != 1 ||
+	    memcmp(hdr.magic, ATLAS_MAGIC, sizeof (hdr.magic)) != 0 ||
+	    hdr.version != ATLAS_VERSION || hdr.key != key ||
+	    hdr.n_icons != n || fread(recs, sizeof (*recs), n, fp) != n)
+		goto out;
+	for (size_t i = 0; i < n; i++) {
+		if (strncmp(recs[i].filename, btns[i]->filename,
+		    sizeof (recs[i].filename)) != 0 ||
+		    recs[i].x + recs[i].w > hdr.w ||
+		    recs[i].y + recs[i].h > hdr.h)
+			goto out;
+	}
+
+	sz = (size_t)hdr.w * hdr.h * ICON_BPP;
+	pixels = malloc(sz);
+	VERIFY(pixels != NULL);
+	if (fread(pixels, 1, sz, fp) != sz) {
+		logMsg("Error reading icon cache %s: file truncated",
+		    filename);
+		free(pixels);
+		pixels = NULL;
+		goto out;
+	}
+	*w = hdr.w;
+	*h = hdr.h;
+
+out:
+	if (fp != NULL)
+		fclose(fp);
+	free(filename);
+
+	return (pixels);
+}
+
+static void
+atlas_cache_store(const char *lang, uint64_t key, size_t n,
+    const atlas_rec_t *recs, const uint8_t *pixels, int w, int h)
+{
+	char *dirname = mkpathname(ATLAS_DIRS, NULL);
+	char *filename = atlas_cache_path(lang);
+	FILE *fp = NULL;
+	atlas_hdr_t hdr = { .version = ATLAS_VERSION, .n_icons = n,
+	    .key = key, .w = w, .h = h };
+	size_t sz = (size_t)w * h * ICON_BPP;
+
+	memcpy(hdr.magic, ATLAS_MAGIC, sizeof (hdr.magic));
+
+	if (!file_exists(dirname, NULL) &&
+	    !create_directory_recursive(dirname))
+		goto out;
+	fp = fopen(filename, "wb");
+	if (fp == NULL) {
+		logMsg("Error writing file %s: %s", filename, strerror(errno));
+		goto out;
+	}
+	if (fwrite(&hdr, sizeof (hdr), 1, fp) != 1 ||
+	    fwrite(recs, sizeof (*recs), n, fp) != n ||
+	    fwrite(pixels, 1, sz, fp) != sz) {
+		logMsg("Error writing file %s: %s", filename, strerror(errno));
+		fclose(fp);
+		fp = NULL;
+		/* don't leave a truncated cache lying around */
+		remove_file(filename, B_TRUE);
+	}
+
+out:
+	if (fp != NULL)
+		fclose(fp);
+	free(dirname);
+	free(filename);
+}
+
+/*
+ * Loads the icons of all buttons in `btns' (spacers are skipped) into a
+ * single texture atlas for language `lang'. On success, each button's
+ * `tex' is set to the atlas texture, `w' & `h' to the icon's size and
+ * `s0'-`t1' to the icon's texture coordinates within the atlas.
+ *
+ * This is a no-op if the atlas for `lang' is already loaded. The buttons
+ * must stay valid until icon_atlas_unload is called. Must be called with
+ * a GL context current.
+ */
+bool_t
+icon_atlas_load(const char *lang, button_t *const *btns, size_t n)
+{
+	atlas_rec_t recs[MAX_ICONS];
+	uint64_t key;
+	uint8_t *pixels;
+	int w = 0, h = 0;
+	GLint max_tex_sz = 0;
+
+	ASSERT(lang != NULL);
+	ASSERT3U(n, <=, MAX_ICONS);
+
+	if (atlas.tex != 0 && strcmp(atlas.lang, lang) == 0 &&
+	    atlas.n_btns == n && memcmp(atlas.btns, btns,
+	    n * sizeof (*btns)) == 0)
+		return (B_TRUE);
+	icon_atlas_unload();
+
+	if (!atlas_key(lang, btns, n, &key))
+		return (B_FALSE);
+	pixels = atlas_cache_load(lang, key, btns, n, recs, &w, &h);
+	if (pixels == NULL) {
+		pixels = atlas_build(lang, btns, n, recs, &w, &h);
+		if (pixels == NULL)
+			return (B_FALSE);
+		atlas_cache_store(lang, key, n, recs, pixels, w, h);
+	}
+
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_tex_sz);
+	if (w > max_tex_sz || h > max_tex_sz) {
+		logMsg("Cannot load icons: atlas size %dx%d exceeds maximum "
+		    "texture size %d", w, h, max_tex_sz);
+		free(pixels);
+		return (B_FALSE);
+	}
+
+	glGenTextures(1, &atlas.tex);
+	XPLMBindTexture2d(atlas.tex, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0, GL_RGBA,
+	    GL_UNSIGNED_BYTE, pixels);
+	XPLMBindTexture2d(0, 0);
+	/* the GL has its own copy now */
+	free(pixels);
+
+	for (size_t i = 0; i < n; i++) {
+		button_t *btn = btns[i];
+
+		atlas.btns[i] = btn;
+		if (is_spacer(btn))
+			continue;
+		btn->tex = atlas.tex;
+		btn->w = recs[i].w;
+		btn->h = recs[i].h;
+		btn->s0 = (double)recs[i].x / w;
+		btn->t0 = (double)recs[i].y / h;
+		btn->s1 = (double)(recs[i].x + recs[i].w) / w;
+		btn->t1 = (double)(recs[i].y + recs[i].h) / h;
+	}
+	atlas.n_btns = n;
+	strlcpy(atlas.lang, lang, sizeof (atlas.lang));
+
+	return (B_TRUE);
+}
+
+/*
+ * Deletes the atlas texture and detaches all buttons from it.
+ */
+void
+icon_atlas_unload(void)
+{
+	for (size_t i = 0; i < atlas.n_btns; i++)
+		atlas.btns[i]->tex = 0;
+	if (atlas.tex != 0)
+		glDeleteTextures(1, &atlas.tex);
+	memset(&atlas, 0, sizeof (atlas));
+}
@@ -0,0 +1,37 @@
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+*/
+/*
+ * Copyright 2020 Saso Kiselkov. All rights reserved.
+ */
+
+#ifndef	_ICON_ATLAS_H_
+#define	_ICON_ATLAS_H_
+
+#include <stddef.h>
+
+#include "bp_cam.h"
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+bool_t icon_atlas_load(const char *lang, button_t *const *btns, size_t n);
+void icon_atlas_unload(void);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _ICON_ATLAS_H_ */
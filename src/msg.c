@@ -16,9 +16,11 @@
  * Copyright 2017 Saso Kiselkov. All rights reserved.
  */
 
+#include <math.h>
 #include <string.h>
 #include <errno.h>
 
+#include <XPLMProcessing.h>
 #include <XPLMUtilities.h>
 
 #include <acfutils/assert.h>
@@ -32,29 +34,44 @@
 
 #include "cfg.h"
 #include "msg.h"
+#include "pcm_cache.h"
 #include "xplane.h"
 
+/*
+ * Messages are decoded lazily. msg_init only picks the message directory
+ * and checks that all messages are present. A message is decoded either
+ * when it's first needed (msg_play or msg_dur), or ahead of time when
+ * bp.c predicts it to be next (msg_prefetch). Prefetched messages are
+ * decoded from a flight loop callback, so the decoding doesn't add to the
+ * cost of the pushback state machine's frame. Whenever the prediction
+ * changes, everything except the message last played and the newly
+ * predicted ones is freed, so only a couple of messages stay resident.
+ * A message's duration is remembered once known, so asking for it later
+ * doesn't require decoding it again.
+ */
 typedef struct {
 	const char	*const filename;
 	wav_t		*wav;
+	double		dur;		/* seconds, NAN if not yet known */
+	bool_t		prefetch;	/* predicted to be played next */
 } msg_info_t;
 
 static msg_info_t msgs[MSG_NUM_MSGS] = {
-	{ .filename = "plan_start.opus", .wav = NULL },
-	{ .filename = "plan_end.opus", .wav = NULL },
-	{ .filename = "driving_up.opus", .wav = NULL },
-	{ .filename = "ready2conn.opus", .wav = NULL },
-	{ .filename = "ready2conn_nopark.opus", .wav = NULL },
-	{ .filename = "winch.opus", .wav = NULL },
-	{ .filename = "connected.opus", .wav = NULL },
-	{ .filename = "start_pb.opus", .wav = NULL },
-	{ .filename = "start_tow.opus", .wav = NULL },
-	{ .filename = "start_pb_nostart.opus", .wav = NULL },
-	{ .filename = "start_tow_nostart.opus", .wav = NULL },
-	{ .filename = "op_complete.opus", .wav = NULL },
-	{ .filename = "disco.opus", .wav = NULL },
-	{ .filename = "done_right.opus", .wav = NULL },
-	{ .filename = "done_left.opus", .wav = NULL }
+	{ .filename = "plan_start.opus", .wav = NULL, .dur = NAN },
+	{ .filename = "plan_end.opus", .wav = NULL, .dur = NAN },
+	{ .filename = "driving_up.opus", .wav = NULL, .dur = NAN },
+	{ .filename = "ready2conn.opus", .wav = NULL, .dur = NAN },
+	{ .filename = "ready2conn_nopark.opus", .wav = NULL, .dur = NAN },
+	{ .filename = "winch.opus", .wav = NULL, .dur = NAN },
+	{ .filename = "connected.opus", .wav = NULL, .dur = NAN },
+	{ .filename = "start_pb.opus", .wav = NULL, .dur = NAN },
+	{ .filename = "start_tow.opus", .wav = NULL, .dur = NAN },
+	{ .filename = "start_pb_nostart.opus", .wav = NULL, .dur = NAN },
+	{ .filename = "start_tow_nostart.opus", .wav = NULL, .dur = NAN },
+	{ .filename = "op_complete.opus", .wav = NULL, .dur = NAN },
+	{ .filename = "disco.opus", .wav = NULL, .dur = NAN },
+	{ .filename = "done_right.opus", .wav = NULL, .dur = NAN },
+	{ .filename = "done_left.opus", .wav = NULL, .dur = NAN }
 };
 
 bool_t inited = B_FALSE;
@@ -62,15 +79,42 @@ static dr_t sound_on;
 static dr_t radio_vol;
 static message_t last_msg = 0;
 static alc_t *alc = NULL;
+static char *msg_dir_name = NULL;
+static XPLMFlightLoopID prefetch_floop = NULL;
 
 /*
- * This examines an optional "cc_aliases.cfg" file in our messages directory.
- * This can used to remap a country code to another code to for example
- * utilize the second country's audio set as a common set. One example of
- * this is en_GB, which also applies in British overseas territories.
+ * Index of the voice packs installed in data/msgs. This is built once when
+ * the plugin is enabled, so that picking the voice pack at the start of
+ * every pushback doesn't have to go to the disk. It holds:
+ * 1) the country code remappings from the optional "cc_aliases.cfg" file.
+ *	This can used to remap a country code to another code to for example
+ *	utilize the second country's audio set as a common set. One example
+ *	of this is en_GB, which also applies in British overseas territories.
+ * 2) the sorted names of all voice pack directories. Since the variants
+ *	of a pack "XYZ" are named "XYZ(...)", all variants of a pack form a
+ *	contiguous run in this list.
  */
+typedef struct {
+	char	cc_in[8];
+	char	cc_out[3];
+} cc_alias_t;
+
+static struct {
+	bool_t		inited;
+	cc_alias_t	*aliases;
+	size_t		n_aliases;
+	char		**dirs;
+	size_t		n_dirs;
+} idx;
+
+static int
+dir_name_compar(const void *a, const void *b)
+{
+	return (strcmp(*(const char **)a, *(const char **)b));
+}
+
 static void
-alias_cc(const char *cc, char aliased_cc[3])
+index_aliases(void)
 {
 	char *path = mkpathname(bp_xpdir, bp_plugindir, "data", "msgs",
 	    "cc_aliases.cfg", NULL);
@@ -79,7 +123,7 @@ alias_cc(const char *cc, char aliased_cc[3])
 
 	free(path);
 	if (fp == NULL)
-		goto errout;
+		return;
 
 	while (!feof(fp)) {
 		if (fscanf(fp, "%7s %7s", cc_in, cc_out) != 2)
@@ -91,56 +135,193 @@ alias_cc(const char *cc, char aliased_cc[3])
 			} while (c != '\n' && c != '\r' && c != EOF);
 			continue;
 		}
-		if (strcmp(cc, cc_in) == 0) {
-			strlcpy(aliased_cc, cc_out, 3);
-			fclose(fp);
-			return;
-		}
+		idx.aliases = realloc(idx.aliases, (idx.n_aliases + 1) *
+		    sizeof (*idx.aliases));
+		strlcpy(idx.aliases[idx.n_aliases].cc_in, cc_in,
+		    sizeof (idx.aliases->cc_in));
+		strlcpy(idx.aliases[idx.n_aliases].cc_out, cc_out,
+		    sizeof (idx.aliases->cc_out));
+		idx.n_aliases++;
 	}
 
 	fclose(fp);
-errout:
-	strlcpy(aliased_cc, cc, 3);
 }
 
-static char *
-msg_pack_variant_select(char *base)
+static void
+index_dirs(void)
 {
-	char **variants = NULL;
-	size_t num = 0, pick = 0;
-	char *winner;
 	char *dname = mkpathname(bp_xpdir, bp_plugindir, "data", "msgs", NULL);
 	DIR *dp = opendir(dname);
-	int n = strlen(base);
 
 	if (dp == NULL) {
 		logMsg("Error opening %s: %s", dname, strerror(errno));
 		free(dname);
-		return (base);
+		return;
 	}
 	for (struct dirent *de = readdir(dp); de != NULL; de = readdir(dp)) {
-		if (strcmp(de->d_name, base) == 0 ||
-		    (strncmp(de->d_name, base, n) == 0 &&
-		    de->d_name[n] == '(')) {
-			variants = realloc(variants,
-			    (num + 1) * sizeof (*variants));
-			variants[num++] = strdup(de->d_name);
+		char *path;
+		bool_t isdir;
+
+		if (de->d_name[0] == '.')
+			continue;
+		path = mkpathname(dname, de->d_name, NULL);
+		if (file_exists(path, &isdir) && isdir) {
+			idx.dirs = realloc(idx.dirs, (idx.n_dirs + 1) *
+			    sizeof (*idx.dirs));
+			idx.dirs[idx.n_dirs++] = strdup(de->d_name);
 		}
+		free(path);
 	}
 	closedir(dp);
-
 	free(dname);
-	free(base);
 
-	ASSERT(num != 0);
+	qsort(idx.dirs, idx.n_dirs, sizeof (*idx.dirs), dir_name_compar);
+}
+
+void
+msg_index_init(void)
+{
+	if (idx.inited)
+		return;
+	index_aliases();
+	index_dirs();
+	idx.inited = B_TRUE;
+}
+
+void
+msg_index_fini(void)
+{
+	if (!idx.inited)
+		return;
+	for (size_t i = 0; i < idx.n_dirs; i++)
+		free(idx.dirs[i]);
+	free(idx.dirs);
+	free(idx.aliases);
+	memset(&idx, 0, sizeof (idx));
+}
+
+static void
+alias_cc(const char *cc, char aliased_cc[3])
+{
+	for (size_t i = 0; i < idx.n_aliases; i++) {
+		if (strcmp(cc, idx.aliases[i].cc_in) == 0) {
+			strlcpy(aliased_cc, idx.aliases[i].cc_out, 3);
+			return;
+		}
+	}
+	strlcpy(aliased_cc, cc, 3);
+}
+
+/*
+ * Returns the index of the first directory name in the index which is
+ * lexicographically >= `name'.
+ */
+static size_t
+dir_lower_bound(const char *name)
+{
+	size_t lo = 0, hi = idx.n_dirs;
+
+	while (lo < hi) {
+		size_t mid = (lo + hi) / 2;
+
+		if (strcmp(idx.dirs[mid], name) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return (lo);
+}
+
+static bool_t
+pack_exists(const char *name)
+{
+	size_t i = dir_lower_bound(name);
+	return (i < idx.n_dirs && strcmp(idx.dirs[i], name) == 0);
+}
+
+static char *
+msg_pack_variant_select(char *base)
+{
+	size_t n = strlen(base);
+	size_t first = dir_lower_bound(base);
+	size_t num = 0, pick;
+	const char *variants[64];
+
+	for (size_t i = first; i < idx.n_dirs && num < ARRAY_NUM_ELEM(variants);
+	    i++) {
+		const char *name = idx.dirs[i];
+
+		if (strncmp(name, base, n) != 0)
+			break;
+		if (name[n] == '\0' || name[n] == '(')
+			variants[num++] = name;
+	}
+	if (num == 0)
+		return (base);
+
 	pick = crc64_rand() % num;
-	winner = variants[pick];
-	variants[pick] = NULL;
-	for (size_t i = 0; i < num; i++)
-		free(variants[i]);
-	free(variants);
+	free(base);
+
+	return (strdup(variants[pick]));
+}
+
+static char *
+msg_path(message_t msg)
+{
+	ASSERT(msg_dir_name != NULL);
+	return (mkpathname(bp_xpdir, bp_plugindir, "data", "msgs",
+	    msg_dir_name, msgs[msg].filename, NULL));
+}
+
+static bool_t
+msg_load(message_t msg)
+{
+	char *path;
+
+	if (msgs[msg].wav != NULL)
+		return (B_TRUE);
+
+	path = msg_path(msg);
+	msgs[msg].wav = pcm_cache_wav_load(path, msgs[msg].filename, alc);
+	if (msgs[msg].wav == NULL) {
+		logMsg("Unable to load sound file %s", path);
+		free(path);
+		return (B_FALSE);
+	}
+	free(path);
+	msgs[msg].dur = msgs[msg].wav->duration;
+
+	return (B_TRUE);
+}
 
-	return (winner);
+static void
+msg_unload(message_t msg)
+{
+	if (msgs[msg].wav != NULL) {
+		wav_free(msgs[msg].wav);
+		msgs[msg].wav = NULL;
+	}
+}
+
+/*
+ * Decodes one outstanding prefetched message per invocation, so as not
+ * to cause a frame rate hiccup when several of them are predicted.
+ */
+static float
+prefetch_floop_cb(float elapsed, float elapsed2, int counter, void *refcon)
+{
+	UNUSED(elapsed);
+	UNUSED(elapsed2);
+	UNUSED(counter);
+	UNUSED(refcon);
+
+	for (message_t msg = 0; msg < MSG_NUM_MSGS; msg++) {
+		if (msgs[msg].prefetch && msgs[msg].wav == NULL) {
+			msgs[msg].prefetch = msg_load(msg);
+			return (-1);
+		}
+	}
+	return (0);
 }
 
 bool_t
@@ -150,8 +331,13 @@ msg_init(const char *my_lang, const char *icao, lang_pref_t lang_pref)
 	const char *arpt_lang = icao2lang(icao);
 	enum { MAX_MATCHES = 4 };
 	char match_set[MAX_MATCHES][8] = { {0}, {0}, {0}, {0} };
-	char *msg_dir_name = NULL;
 	char cc[3];
+	XPLMCreateFlightLoop_t floop = {
+	    .structSize = sizeof (floop),
+	    .phase = xplm_FlightLoop_Phase_AfterFlightModel,
+	    .callbackFunc = prefetch_floop_cb,
+	    .refcon = NULL
+	};
 	const char *radio_dev = NULL;
 	bool_t shared_ctx = B_FALSE;
 
@@ -214,19 +400,10 @@ msg_init(const char *my_lang, const char *icao, lang_pref_t lang_pref)
 	};
 
 	for (int i = 0; i < MAX_MATCHES; i++) {
-		char *path;
-		bool_t isdir;
-
-		if (*match_set[i] == 0)
-			continue;
-		path = mkpathname(bp_xpdir, bp_plugindir, "data", "msgs",
-		    match_set[i], NULL);
-		if (file_exists(path, &isdir) && isdir) {
-			free(path);
+		if (*match_set[i] != 0 && pack_exists(match_set[i])) {
 			msg_dir_name = strdup(match_set[i]);
 			break;
 		}
-		free(path);
 	}
 
 	if (msg_dir_name == NULL) {
@@ -235,18 +412,18 @@ msg_init(const char *my_lang, const char *icao, lang_pref_t lang_pref)
 	}
 
 	/*
-	 * To support multiple sound pack variants, we look through data/msgs
-	 * again to look for variations of 'msg_dir_name(XYZ)', where
+	 * To support multiple sound pack variants, we look through the pack
+	 * index for variations of 'msg_dir_name(XYZ)', where
 	 * msg_dir_name is the message directory we selected above. If there
 	 * are multiple matching ones, we randomly select one.
 	 */
 	msg_dir_name = msg_pack_variant_select(msg_dir_name);
 
+	/* only check that the files are there, decoding happens later */
 	for (message_t msg = 0; msg < MSG_NUM_MSGS; msg++) {
-		char *path = mkpathname(bp_xpdir, bp_plugindir, "data",
-		    "msgs", msg_dir_name, msgs[msg].filename, NULL);
-		msgs[msg].wav = wav_load(path, msgs[msg].filename, alc);
-		if (msgs[msg].wav == NULL) {
+		char *path = msg_path(msg);
+
+		if (!file_exists(path, NULL)) {
 			logMsg("BetterPushback initialization error, unable "
 			    "to load sound file %s (prefdir: %s)", path,
 			    msg_dir_name);
@@ -254,23 +431,20 @@ msg_init(const char *my_lang, const char *icao, lang_pref_t lang_pref)
 			goto errout;
 		}
 		free(path);
+		msgs[msg].dur = NAN;
+		msgs[msg].prefetch = B_FALSE;
 	}
 
-	free(msg_dir_name);
 	fdr_find(&sound_on, "sim/operation/sound/sound_on");
 	fdr_find(&radio_vol, "sim/operation/sound/radio_volume_ratio");
+	prefetch_floop = XPLMCreateFlightLoop(&floop);
 
 	inited = B_TRUE;
 
 	return (B_TRUE);
 errout:
 	free(msg_dir_name);
-	for (message_t msg = 0; msg < MSG_NUM_MSGS; msg++) {
-		if (msgs[msg].wav != NULL) {
-			wav_free(msgs[msg].wav);
-			msgs[msg].wav = NULL;
-		}
-	}
+	msg_dir_name = NULL;
 	if (alc != NULL) {
 		openal_fini(alc);
 		alc = NULL;
@@ -283,12 +457,12 @@ msg_fini(void)
 {
 	if (!inited)
 		return;
-	for (message_t msg = 0; msg < MSG_NUM_MSGS; msg++) {
-		if (msgs[msg].wav != NULL) {
-			wav_free(msgs[msg].wav);
-			msgs[msg].wav = NULL;
-		}
-	}
+	XPLMDestroyFlightLoop(prefetch_floop);
+	prefetch_floop = NULL;
+	for (message_t msg = 0; msg < MSG_NUM_MSGS; msg++)
+		msg_unload(msg);
+	free(msg_dir_name);
+	msg_dir_name = NULL;
 	if (alc != NULL) {
 		openal_fini(alc);
 		alc = NULL;
@@ -296,6 +470,32 @@ msg_fini(void)
 	inited = B_FALSE;
 }
 
+/*
+ * Tells us which messages are likely to be played next. These get decoded
+ * in the background over the next few frames, while any other decoded
+ * messages, except for the one last played, are freed.
+ */
+void
+msg_prefetch(const message_t *next, size_t n)
+{
+	bool_t want[MSG_NUM_MSGS] = { B_FALSE };
+
+	ASSERT(inited);
+	ASSERT(next != NULL || n == 0);
+
+	for (size_t i = 0; i < n; i++) {
+		VERIFY3U(next[i], <, MSG_NUM_MSGS);
+		want[next[i]] = B_TRUE;
+	}
+	for (message_t msg = 0; msg < MSG_NUM_MSGS; msg++) {
+		msgs[msg].prefetch = want[msg];
+		if (!want[msg] && msg != last_msg)
+			msg_unload(msg);
+	}
+	if (n != 0)
+		XPLMScheduleFlightLoop(prefetch_floop, -1, 1);
+}
+
 void
 msg_play(message_t msg)
 {
@@ -303,6 +503,8 @@ msg_play(message_t msg)
 	ASSERT(inited);
 	if (dr_geti(&sound_on) == 0)
 		return;
+	if (!msg_load(msg))
+		return;
 	wav_set_gain(msgs[msg].wav, dr_getf(&radio_vol));
 	wav_play(msgs[msg].wav);
 	last_msg = msg;
@@ -312,7 +514,8 @@ void
 msg_stop(void)
 {
 	ASSERT(inited);
-	wav_stop(msgs[last_msg].wav);
+	if (msgs[last_msg].wav != NULL)
+		wav_stop(msgs[last_msg].wav);
 }
 
 double
@@ -320,5 +523,7 @@ msg_dur(message_t msg)
 {
 	VERIFY3U(msg, <, MSG_NUM_MSGS);
 	ASSERT(inited);
-	return (msgs[msg].wav->duration);
+	if (isnan(msgs[msg].dur) && !msg_load(msg))
+		return (0);
+	return (msgs[msg].dur);
 }
@@ -19,6 +19,8 @@
 #ifndef	_MSG_H_
 #define	_MSG_H_
 
+#include <stddef.h>
+
 #include <acfutils/types.h>
 
 #ifdef	__cplusplus
@@ -50,8 +52,12 @@ typedef enum {
 	MSG_NUM_MSGS
 } message_t;
 
+void msg_index_init(void);
+void msg_index_fini(void);
+
 bool_t msg_init(const char *my_lang, const char *icao, lang_pref_t lang_pref);
 void msg_fini();
+void msg_prefetch(const message_t *next, size_t n);
 void msg_play(message_t msg);
 void msg_stop(void);
 double msg_dur(message_t msg);
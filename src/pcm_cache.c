@@ -0,0 +1,330 @@
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+*/
+/*
+ * Copyright 2020 Saso Kiselkov. All rights reserved.
+ */
+
+/*
+ * Cache of decoded sound files. Decoding Opus is what makes loading the
+ * voice messages expensive, so the first time we load an Opus file, we
+ * decode it into plain 16-bit PCM and store that as a RIFF WAVE file in
+ * Output/caches/BetterPushback_pcm. Subsequent loads of the same sound
+ * hand the cached file to wav_load, which then merely copies the samples
+ * into an OpenAL buffer.
+ *
+ * Cache entries are content-addressed: an entry's name is the CRC64 of
+ * the source file's contents and of the PCM format we decode into. So
+ * an entry never goes stale, identical sounds shipped in several voice
+ * packs share an entry, and changing the format simply orphans the old
+ * entries. Those eventually get removed by pcm_cache_trim, which keeps
+ * the total size of the cache below MAX_CACHE_SIZE by removing the
+ * least recently used entries (each use bumps the entry's mtime).
+ *
+ * Sounds which already are WAV files are passed straight to wav_load.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <utime.h>
+
+#include <opusfile.h>
+
+#include <acfutils/assert.h>
+#include <acfutils/crc64.h>
+#include <acfutils/helpers.h>
+#include <acfutils/log.h>
+
+#include "pcm_cache.h"
+#include "xplane.h"
+
+#define	PCM_DIRS	bp_xpdir, "Output", "caches", "BetterPushback_pcm"
+#define	PCM_VERSION	1
+#define	PCM_RATE	48000		/* Hz, what opusfile decodes to */
+#define	PCM_BITS	16		/* bits per sample */
+#define	MAX_CHANNELS	2		/* what OpenAL can take */
+#define	MAX_CACHE_SIZE	(64 << 20)	/* bytes */
+#define	HASH_BUFSZ	65536		/* bytes */
+
+/*
+ * Canonical 44-byte RIFF WAVE header. Like everything else we cache,
+ * this is written in native byte order, which is little endian on all
+ * platforms X-Plane runs on.
+ */
+typedef struct {
+	char		riff[4];	/* "RIFF" */
+	uint32_t	riff_sz;	/* file size - 8 */
+	char		wave[4];	/* "WAVE" */
+	char		fmt[4];		/* "fmt " */
+	uint32_t	fmt_sz;		/* 16 */
+	uint16_t	datafmt;	/* 1 = PCM */
+	uint16_t	n_chans;
+	uint32_t	srate;		/* Hz */
+	uint32_t	byte_rate;	/* bytes per second */
+	uint16_t	align;		/* bytes per sample frame */
+	uint16_t	bps;		/* bits per sample */
+	char		data[4];	/* "data" */
+	uint32_t	data_sz;	/* bytes of samples */
+} riff_hdr_t;
+
+typedef struct {
+	char		*path;
+	time_t		mtime;
+	uint64_t	size;
+} cache_ent_t;
+
+static bool_t
+is_opus(const char *path)
+{
+	size_t l = strlen(path);
+	return (l > 5 && strcmp(&path[l - 5], ".opus") == 0);
+}
+
+/*
+ * Computes the cache key of the source sound file `path'.
+ */
+static bool_t
+src_hash(const char *path, uint64_t *key)
+{
+	const uint32_t fmt[] = { PCM_VERSION, PCM_RATE, PCM_BITS };
+	FILE *fp = fopen(path, "rb");
+	uint8_t *buf;
+	size_t n;
+	uint64_t crc = 0;
+
+	if (fp == NULL) {
+		logMsg("Error reading %s: %s", path, strerror(errno));
+		return (B_FALSE);
+	}
+	buf = malloc(HASH_BUFSZ);
+	while ((n = fread(buf, 1, HASH_BUFSZ, fp)) != 0)
+		crc = crc64_append(crc, buf, n);
+	free(buf);
+	fclose(fp);
+	*key = crc64_append(crc, fmt, sizeof (fmt));
+
+	return (B_TRUE);
+}
+
+static char *
+pcm_cache_path(uint64_t key)
+{
+	char filename[32];
+
+	snprintf(filename, sizeof (filename), "%016llx.wav",
+	    (unsigned long long)key);
+	return (mkpathname(PCM_DIRS, filename, NULL));
+}
+
+/*
+ * Decodes the Opus file `src' and writes the result to `filename'. The
+ * data goes into a temporary file first, so a crash can never leave a
+ * truncated entry behind.
+ */
+static bool_t
+pcm_cache_store(const char *src, const char *filename)
+{
+	char *dirname = mkpathname(PCM_DIRS, NULL);
+	char *tmpname = sprintf_alloc("%s.tmp", filename);
+	OggOpusFile *of;
+	opus_int16 *pcm = NULL;
+	ogg_int64_t total;
+	size_t n_samples = 0, data_sz;
+	int chans, err;
+	riff_hdr_t hdr;
+	FILE *fp = NULL;
+	bool_t res = B_FALSE;
+
+	CTASSERT(sizeof (hdr) == 44);
+
+	of = op_open_file(src, &err);
+	if (of == NULL) {
+		logMsg("Error decoding %s: opusfile error %d", src, err);
+		goto out;
+	}
+	chans = op_channel_count(of, -1);
+	total = op_pcm_total(of, -1);
+	if (chans < 1 || chans > MAX_CHANNELS || total <= 0 ||
+	    total * chans * sizeof (*pcm) >= UINT32_MAX - sizeof (hdr)) {
+		logMsg("Error decoding %s: unsupported stream (%d channels, "
+		    "%lld samples)", src, chans, (long long)total);
+		goto out;
+	}
+	pcm = malloc(total * chans * sizeof (*pcm));
+	VERIFY(pcm != NULL);
+	while (n_samples < (size_t)total) {
+		int n = op_read(of, &pcm[n_samples * chans],
+		    (total - n_samples) * chans, NULL);
+
+		if (n < 0) {
+			logMsg("Error decoding %s: opusfile error %d", src, n);
+			goto out;
+		}
+		if (n == 0)
+			break;
+		n_samples += n;
+	}
+	data_sz = n_samples * chans * sizeof (*pcm);
+
+	memcpy(hdr.riff, "RIFF", 4);
+	hdr.riff_sz = sizeof (hdr) - 8 + data_sz;
+	memcpy(hdr.wave, "WAVE", 4);
+	memcpy(hdr.fmt, "fmt ", 4);
+	hdr.fmt_sz = 16;
+	hdr.datafmt = 1;
+	hdr.n_chans = chans;
+	hdr.srate = PCM_RATE;
+	hdr.byte_rate = PCM_RATE * chans * sizeof (*pcm);
+	hdr.align = chans * sizeof (*pcm);
+	hdr.bps = PCM_BITS;
+	memcpy(hdr.data, "data", 4);
+	hdr.data_sz = data_sz;
+
+	if (!file_exists(dirname, NULL) &&
+	    !create_directory_recursive(dirname))
+		goto out;
+	fp = fopen(tmpname, "wb");
+	if (fp == NULL) {
+		logMsg("Error writing file %s: %s", tmpname, strerror(errno));
+		goto out;
+	}
+	if (fwrite(&hdr, sizeof (hdr), 1, fp) != 1 ||
+	    fwrite(pcm, 1, data_sz, fp) != data_sz) {
+		logMsg("Error writing file %s: %s", tmpname, strerror(errno));
+		fclose(fp);
+		fp = NULL;
+		remove_file(tmpname, B_TRUE);
+		goto out;
+	}
+	fclose(fp);
+	fp = NULL;
+	if (rename(tmpname, filename) != 0) {
+		logMsg("Error renaming %s to %s: %s", tmpname, filename,
+		    strerror(errno));
+		remove_file(tmpname, B_TRUE);
+		goto out;
+	}
+	res = B_TRUE;
+
+out:
+	if (of != NULL)
+		op_free(of);
+	free(pcm);
+	free(dirname);
+	free(tmpname);
+
+	return (res);
+}
+
+static int
+ent_compar(const void *a, const void *b)
+{
+	const cache_ent_t *ea = a, *eb = b;
+
+	if (ea->mtime < eb->mtime)
+		return (-1);
+	if (ea->mtime > eb->mtime)
+		return (1);
+	return (0);
+}
+
+/*
+ * Removes the least recently used cache entries until the cache fits
+ * into MAX_CACHE_SIZE again.
+ */
+void
+pcm_cache_trim(void)
+{
+	char *dirname = mkpathname(PCM_DIRS, NULL);
+	DIR *dp = opendir(dirname);
+	cache_ent_t *ents = NULL;
+	size_t n_ents = 0;
+	uint64_t total = 0;
+
+	if (dp == NULL) {
+		/* no cache yet */
+		free(dirname);
+		return;
+	}
+	for (struct dirent *de = readdir(dp); de != NULL; de = readdir(dp)) {
+		char *path;
+		struct stat st;
+
+		if (de->d_name[0] == '.')
+			continue;
+		path = mkpathname(dirname, de->d_name, NULL);
+		if (stat(path, &st) < 0 || !S_ISREG(st.st_mode)) {
+			free(path);
+			continue;
+		}
+		ents = realloc(ents, (n_ents + 1) * sizeof (*ents));
+		ents[n_ents].path = path;
+		ents[n_ents].mtime = st.st_mtime;
+		ents[n_ents].size = st.st_size;
+		total += st.st_size;
+		n_ents++;
+	}
+	closedir(dp);
+
+	qsort(ents, n_ents, sizeof (*ents), ent_compar);
+	for (size_t i = 0; i < n_ents; i++) {
+		if (total > MAX_CACHE_SIZE) {
+			remove_file(ents[i].path, B_FALSE);
+			total -= ents[i].size;
+		}
+		free(ents[i].path);
+	}
+	free(ents);
+	free(dirname);
+}
+
+/*
+ * Drop-in replacement for wav_load, which goes through the cache for
+ * Opus files.
+ */
+wav_t *
+pcm_cache_wav_load(const char *path, const char *name, alc_t *alc)
+{
+	uint64_t key;
+	char *filename;
+	wav_t *wav;
+
+	if (!is_opus(path) || !src_hash(path, &key))
+		return (wav_load(path, name, alc));
+
+	filename = pcm_cache_path(key);
+	if (file_exists(filename, NULL)) {
+		/* mark the entry as recently used */
+		(void) utime(filename, NULL);
+	} else if (pcm_cache_store(path, filename)) {
+		pcm_cache_trim();
+	} else {
+		free(filename);
+		return (wav_load(path, name, alc));
+	}
+
+	wav = wav_load(filename, name, alc);
+	if (wav == NULL) {
+		/* damaged cache entry, drop it and fall back to the source */
+		logMsg("Error loading cached sound %s, removing it", filename);
+		remove_file(filename, B_FALSE);
+		wav = wav_load(path, name, alc);
+	}
+	free(filename);
+
+	return (wav);
+}
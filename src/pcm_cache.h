@@ -0,0 +1,35 @@
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+*/
+/*
+ * Copyright 2020 Saso Kiselkov. All rights reserved.
+ */
+
+#ifndef	_PCM_CACHE_H_
+#define	_PCM_CACHE_H_
+
+#include <acfutils/wav.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+void pcm_cache_trim(void);
+wav_t *pcm_cache_wav_load(const char *path, const char *name, alc_t *alc);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _PCM_CACHE_H_ */
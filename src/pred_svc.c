@@ -0,0 +1,209 @@
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+*/
+/*
+ * Copyright 2020 Saso Kiselkov. All rights reserved.
+ */
+
+
+/*
+ * The prediction service computes the planner's hover prediction (the
+ * segments from the end of the route to the cursor) on a worker thread,
+ * so that expensive or failing solves in compute_segs can't stall the
+ * camera callback.
+ *
+ * Requests go into a single-slot mailbox: posting a new request simply
+ * overwrites any request the worker hasn't picked up yet, so the worker
+ * only ever solves for the latest cursor position. Likewise, a completed
+ * prediction sits in a single result slot until the planner collects it
+ * (or a newer one replaces it). Until then, the planner keeps drawing the
+ * last prediction it collected.
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <acfutils/assert.h>
+#include <acfutils/log.h>
+#include <acfutils/thread.h>
+
+#include "pred_svc.h"
+
+typedef struct {
+	vehicle_t	veh;
+	vect2_t		start_pos;
+	double		start_hdg;
+	vect2_t		end_pos;
+	double		end_hdg;
+} pred_rqst_t;
+
+static struct {
+	bool_t		inited;
+	thread_t	worker;
+	mutex_t		lock;
+	condvar_t	cv;
+	bool_t		shutdown;
+
+	bool_t		rqst_pending;
+	pred_rqst_t	rqst;
+
+	bool_t		result_ready;
+	pred_rqst_t	result_rqst;	/* request that produced `result' */
+	list_t		result;
+} ps;
+
+static void
+segs_free(list_t *segs)
+{
+	seg_t *seg;
+
+	while ((seg = list_remove_head(segs)) != NULL)
+		free(seg);
+}
+
+static void
+pred_worker(void *unused)
+{
+	UNUSED(unused);
+
+	mutex_enter(&ps.lock);
+	while (!ps.shutdown) {
+		pred_rqst_t rqst;
+		list_t segs;
+		int n;
+
+		if (!ps.rqst_pending) {
+			cv_wait(&ps.cv, &ps.lock);
+			continue;
+		}
+		rqst = ps.rqst;
+		ps.rqst_pending = B_FALSE;
+		mutex_exit(&ps.lock);
+
+		list_create(&segs, sizeof (seg_t), offsetof(seg_t, node));
+		n = compute_segs(&rqst.veh, rqst.start_pos, rqst.start_hdg,
+		    rqst.end_pos, rqst.end_hdg, &segs);
+		if (n > 0) {
+			seg_t *seg = list_tail(&segs);
+			seg->user_placed = B_TRUE;
+		} else {
+			segs_free(&segs);
+		}
+
+		mutex_enter(&ps.lock);
+		segs_free(&ps.result);
+		list_move_tail(&ps.result, &segs);
+		list_destroy(&segs);
+		ps.result_rqst = rqst;
+		ps.result_ready = B_TRUE;
+	}
+	mutex_exit(&ps.lock);
+}
+
+bool_t
+pred_svc_init(void)
+{
+	if (ps.inited)
+		return (B_TRUE);
+
+	memset(&ps, 0, sizeof (ps));
+	mutex_init(&ps.lock);
+	cv_init(&ps.cv);
+	list_create(&ps.result, sizeof (seg_t), offsetof(seg_t, node));
+	if (!thread_create(&ps.worker, pred_worker, NULL)) {
+		logMsg("Error creating planner prediction thread");
+		list_destroy(&ps.result);
+		cv_destroy(&ps.cv);
+		mutex_destroy(&ps.lock);
+		return (B_FALSE);
+	}
+	ps.inited = B_TRUE;
+
+	return (B_TRUE);
+}
+
+void
+pred_svc_fini(void)
+{
+	if (!ps.inited)
+		return;
+
+	mutex_enter(&ps.lock);
+	ps.shutdown = B_TRUE;
+	cv_broadcast(&ps.cv);
+	mutex_exit(&ps.lock);
+	thread_join(&ps.worker);
+
+	segs_free(&ps.result);
+	list_destroy(&ps.result);
+	cv_destroy(&ps.cv);
+	mutex_destroy(&ps.lock);
+	memset(&ps, 0, sizeof (ps));
+}
+
+/*
+ * Asks the worker to compute the segments needed to get `veh' from
+ * `start_pos' & `start_hdg' to `end_pos' & `end_hdg'. Replaces any
+ * request which the worker hasn't started on yet.
+ */
+void
+pred_svc_request(const vehicle_t *veh, vect2_t start_pos, double start_hdg,
+    vect2_t end_pos, double end_hdg)
+{
+	ASSERT(ps.inited);
+	ASSERT(veh != NULL);
+
+	mutex_enter(&ps.lock);
+	ps.rqst.veh = *veh;
+	ps.rqst.start_pos = start_pos;
+	ps.rqst.start_hdg = start_hdg;
+	ps.rqst.end_pos = end_pos;
+	ps.rqst.end_hdg = end_hdg;
+	ps.rqst_pending = B_TRUE;
+	cv_broadcast(&ps.cv);
+	mutex_exit(&ps.lock);
+}
+
+/*
+ * If a new prediction has been completed since the last call, replaces
+ * the contents of `segs' with it and returns B_TRUE. Predictions which
+ * don't start at `start_pos' & `start_hdg' are stale (the route changed
+ * since they were requested) and are discarded. If nothing new is
+ * available, `segs' is left untouched and B_FALSE is returned.
+ */
+bool_t
+pred_svc_collect(list_t *segs, vect2_t start_pos, double start_hdg)
+{
+	bool_t collected = B_FALSE;
+
+	ASSERT(ps.inited);
+	ASSERT(segs != NULL);
+
+	mutex_enter(&ps.lock);
+	if (ps.result_ready) {
+		if (VECT2_EQ(ps.result_rqst.start_pos, start_pos) &&
+		    ps.result_rqst.start_hdg == start_hdg) {
+			segs_free(segs);
+			list_move_tail(segs, &ps.result);
+			collected = B_TRUE;
+		} else {
+			segs_free(&ps.result);
+		}
+		ps.result_ready = B_FALSE;
+	}
+	mutex_exit(&ps.lock);
+
+	return (collected);
+}
@@ -0,0 +1,43 @@
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+*/
+/*
+ * Copyright 2020 Saso Kiselkov. All rights reserved.
+ */
+
+
+#ifndef	_PRED_SVC_H_
+#define	_PRED_SVC_H_
+
+#include <acfutils/geom.h>
+#include <acfutils/list.h>
+
+#include "driving.h"
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+bool_t pred_svc_init(void);
+void pred_svc_fini(void);
+
+void pred_svc_request(const vehicle_t *veh, vect2_t start_pos,
+    double start_hdg, vect2_t end_pos, double end_hdg);
+bool_t pred_svc_collect(list_t *segs, vect2_t start_pos, double start_hdg);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _PRED_SVC_H_ */
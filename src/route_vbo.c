@@ -0,0 +1,331 @@
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+*/
+/*
+ * Copyright 2020 Saso Kiselkov. All rights reserved.
+ */
+
+/*
+ * Turn arcs are tessellated based on how large they appear on screen:
+ * each arc is split into equal angular steps, just small enough that no
+ * chord deviates from the true arc by more than MAX_ARC_ERR pixels. The
+ * scale (pixels per meter) is quantized into ZOOM_BUCKETS buckets per
+ * doubling, with each bucket tessellating for the largest scale it covers.
+ * The vertices of each segment are cached (keyed by the segment geometry
+ * and the zoom bucket), so zooming within a bucket, or adding a segment
+ * to a route, doesn't re-tessellate the segments that were already there.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <acfutils/assert.h>
+#include <acfutils/geom.h>
+#include <acfutils/math.h>
+
+#include "driving.h"
+#include "route_vbo.h"
+#include "terr_cache.h"
+
+#define	MAX_ARC_ERR		0.5	/* pixels */
+#define	MIN_ANGLE_STEP		0.25	/* degrees */
+#define	MAX_ANGLE_STEP		30	/* degrees */
+#define	ZOOM_BUCKETS		4	/* per doubling of scale */
+
+typedef struct {
+	GLfloat		*v;		/* x, y, z triplets */
+	unsigned	n;		/* number of vertices */
+	unsigned	cap;
+} vtx_buf_t;
+
+struct seg_tess {
+	uint64_t	key;		/* hash of segment geometry & zoom */
+	vtx_buf_t	ctr;
+	vtx_buf_t	wing;
+};
+
+static void
+vtx_add(vtx_buf_t *buf, vect2_t p, double h)
+{
+	if (buf->n == buf->cap) {
+		buf->cap = MAX(buf->cap * 2, 16);
+		buf->v = realloc(buf->v, buf->cap * 3 * sizeof (*buf->v));
+	}
+	/* X-Plane's Z axis is flipped to ours */
+	buf->v[buf->n * 3] = p.x;
+	buf->v[buf->n * 3 + 1] = h;
+	buf->v[buf->n * 3 + 2] = -p.y;
+	buf->n++;
+}
+
+/* FNV-1a over the bits of the route geometry */
+static uint64_t
+hash_add(uint64_t h, double val)
+{
+	const uint8_t *p = (const uint8_t *)&val;
+
+	for (size_t i = 0; i < sizeof (val); i++) {
+		h ^= p[i];
+		h *= 1099511628211ull;
+	}
+	return (h);
+}
+
+static uint64_t
+seg_hash(const seg_t *seg, vect2_t wing_off, int zoom_bucket)
+{
+	uint64_t h = 14695981039346656037ull;
+
+	/* heights come from the terrain cache, rebuild when it's flushed */
+	h = hash_add(h, terr_cache_gen());
+	h = hash_add(h, wing_off.x);
+	h = hash_add(h, wing_off.y);
+	h = hash_add(h, seg->type);
+	h = hash_add(h, seg->backward);
+	h = hash_add(h, seg->start_pos.x);
+	h = hash_add(h, seg->start_pos.y);
+	h = hash_add(h, seg->start_hdg);
+	h = hash_add(h, seg->end_pos.x);
+	h = hash_add(h, seg->end_pos.y);
+	h = hash_add(h, seg->end_hdg);
+	if (seg->type == SEG_TYPE_TURN) {
+		h = hash_add(h, seg->turn.r);
+		h = hash_add(h, seg->turn.right);
+		/* only turns depend on the zoom level */
+		h = hash_add(h, zoom_bucket);
+	}
+	return (h);
+}
+
+static void
+build_straight(const seg_t *seg, vect2_t wing_off_l, vect2_t wing_off_r,
+    vtx_buf_t *ctr, vtx_buf_t *wing)
+{
+	double h1 = terr_cache_height(seg->start_pos);
+	double h2 = terr_cache_height(seg->end_pos);
+	vect2_t wing_l = vect2_rot(wing_off_l, seg->start_hdg);
+	vect2_t wing_r = vect2_rot(wing_off_r, seg->start_hdg);
+
+	vtx_add(ctr, seg->start_pos, h1);
+	vtx_add(ctr, seg->end_pos, h2);
+
+	vtx_add(wing, vect2_add(seg->start_pos, wing_r), h1);
+	vtx_add(wing, vect2_add(seg->end_pos, wing_r), h1);
+	vtx_add(wing, vect2_add(seg->end_pos, wing_l), h1);
+	vtx_add(wing, vect2_add(seg->start_pos, wing_l), h1);
+}
+
+/*
+ * Returns the largest angular step (in degrees) at which the chords of an
+ * arc of radius `r' stay within MAX_ARC_ERR pixels of the arc at a scale
+ * of `px_per_m' pixels per meter.
+ */
+static double
+arc_angle_step(double r, double px_per_m)
+{
+	double max_err = MAX_ARC_ERR / px_per_m;
+
+	if (max_err >= r)
+		return (MAX_ANGLE_STEP);
+	/* the sagitta of a chord spanning angle `a' is r * (1 - cos(a / 2)) */
+	return (MAX(MIN(RAD2DEG(2 * acos(1 - max_err / r)), MAX_ANGLE_STEP),
+	    MIN_ANGLE_STEP));
+}
+
+static void
+build_turn(const seg_t *seg, vect2_t wing_off_l, vect2_t wing_off_r,
+    double px_per_m, vtx_buf_t *ctr, vtx_buf_t *wing)
+{
+	vect2_t c = vect2_add(seg->start_pos, vect2_scmul(
+	    vect2_norm(hdg2dir(seg->start_hdg), seg->turn.right),
+	    seg->turn.r));
+	vect2_t c2s = vect2_sub(seg->start_pos, c);
+	double s, e, rhdg, step;
+	int n;
+
+	rhdg = rel_hdg(seg->start_hdg, seg->end_hdg);
+	s = MIN(0, rhdg);
+	e = MAX(0, rhdg);
+	ASSERT3F(s, <=, e);
+	if (e - s == 0)
+		return;
+	/* the wingtips sweep the widest arc, so they set the step size */
+	step = arc_angle_step(seg->turn.r + vect2_abs(wing_off_r), px_per_m);
+	n = ceil((e - s) / step);
+	step = (e - s) / n;
+
+	for (int i = 0; i < n; i++) {
+		double a = s + i * step;
+		vect2_t wing1_l = vect2_rot(wing_off_l, seg->start_hdg + a);
+		vect2_t wing1_r = vect2_rot(wing_off_r, seg->start_hdg + a);
+		vect2_t wing2_l = vect2_rot(wing_off_l,
+		    seg->start_hdg + a + step);
+		vect2_t wing2_r = vect2_rot(wing_off_r,
+		    seg->start_hdg + a + step);
+		vect2_t p1 = vect2_add(c, vect2_rot(c2s, a));
+		vect2_t p2 = vect2_add(c, vect2_rot(c2s, a + step));
+		double h = terr_cache_height(p1);
+
+		vtx_add(ctr, p1, h);
+		vtx_add(ctr, p2, h);
+
+		vtx_add(wing, vect2_add(p1, wing1_r), h);
+		vtx_add(wing, vect2_add(p2, wing2_r), h);
+		vtx_add(wing, vect2_add(p1, wing1_l), h);
+		vtx_add(wing, vect2_add(p2, wing2_l), h);
+	}
+}
+
+static void
+seg_tess_free(struct seg_tess *tess)
+{
+	free(tess->ctr.v);
+	free(tess->wing.v);
+}
+
+/*
+ * Makes sure the vertex buffer in `rv' holds the geometry of `segs', as
+ * drawn at a scale of `px_per_m' pixels per meter. This is cheap if the
+ * segments and zoom bucket haven't changed since the last call, otherwise
+ * the vertex buffer is re-uploaded, with only new or changed segments
+ * being re-tessellated. Terrain heights come from the planner's terrain
+ * cache (see terr_cache.c). Must be called with a GL context current.
+ */
+void
+route_vbo_update(route_vbo_t *rv, const list_t *segs,
+    const acf_outline_t *outline, double main_z, double px_per_m)
+{
+	vect2_t wing_off_l = VECT2(-outline->semispan,
+	    main_z - outline->wingtip.y);
+	vect2_t wing_off_r = VECT2(outline->semispan,
+	    main_z - outline->wingtip.y);
+	int zoom_bucket;
+	double bucket_px_per_m;
+	unsigned n_segs = list_count(segs), n_ctr = 0, n_wing = 0, i;
+	struct seg_tess *tess;
+	uint64_t hash = 14695981039346656037ull;
+	GLintptr off;
+
+	ASSERT3F(px_per_m, >, 0);
+	zoom_bucket = ceil(log2(px_per_m) * ZOOM_BUCKETS);
+	bucket_px_per_m = pow(2, (double)zoom_bucket / ZOOM_BUCKETS);
+
+	tess = calloc(MAX(n_segs, 1), sizeof (*tess));
+	i = 0;
+	for (const seg_t *seg = list_head(segs); seg != NULL;
+	    seg = list_next(segs, seg), i++) {
+		tess[i].key = seg_hash(seg, wing_off_r, zoom_bucket);
+		hash = hash_add(hash, tess[i].key);
+	}
+	if (rv->vbo != 0 && rv->hash == hash && rv->n_tess == n_segs) {
+		free(tess);
+		return;
+	}
+
+	i = 0;
+	for (const seg_t *seg = list_head(segs); seg != NULL;
+	    seg = list_next(segs, seg), i++) {
+		/* steal an existing tessellation if we've got one */
+		for (unsigned j = 0; j < rv->n_tess; j++) {
+			if (rv->tess[j].key == tess[i].key &&
+			    rv->tess[j].ctr.v != NULL) {
+				tess[i] = rv->tess[j];
+				memset(&rv->tess[j], 0, sizeof (rv->tess[j]));
+				break;
+			}
+		}
+		if (tess[i].ctr.v == NULL) {
+			if (seg->type == SEG_TYPE_STRAIGHT) {
+				build_straight(seg, wing_off_l, wing_off_r,
+				    &tess[i].ctr, &tess[i].wing);
+			} else {
+				build_turn(seg, wing_off_l, wing_off_r,
+				    bucket_px_per_m, &tess[i].ctr,
+				    &tess[i].wing);
+			}
+		}
+		n_ctr += tess[i].ctr.n;
+		n_wing += tess[i].wing.n;
+	}
+	for (unsigned j = 0; j < rv->n_tess; j++)
+		seg_tess_free(&rv->tess[j]);
+	free(rv->tess);
+	rv->tess = tess;
+	rv->n_tess = n_segs;
+
+	if (rv->vbo == 0)
+		glGenBuffers(1, &rv->vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, rv->vbo);
+	glBufferData(GL_ARRAY_BUFFER, (n_ctr + n_wing) * 3 * sizeof (GLfloat),
+	    NULL, GL_DYNAMIC_DRAW);
+	/* all centerlines first, followed by all wingtip envelopes */
+	off = 0;
+	for (i = 0; i < n_segs; i++) {
+		if (tess[i].ctr.n == 0)
+			continue;
+		glBufferSubData(GL_ARRAY_BUFFER, off,
+		    tess[i].ctr.n * 3 * sizeof (GLfloat), tess[i].ctr.v);
+		off += tess[i].ctr.n * 3 * sizeof (GLfloat);
+	}
+	for (i = 0; i < n_segs; i++) {
+		if (tess[i].wing.n == 0)
+			continue;
+		glBufferSubData(GL_ARRAY_BUFFER, off,
+		    tess[i].wing.n * 3 * sizeof (GLfloat), tess[i].wing.v);
+		off += tess[i].wing.n * 3 * sizeof (GLfloat);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	rv->n_ctr = n_ctr;
+	rv->n_wing = n_wing;
+	rv->hash = hash;
+}
+
+/*
+ * Draws the route: the centerline in blue, the wingtip envelope in
+ * magenta. Uses the current modelview & projection matrices.
+ */
+void
+route_vbo_draw(const route_vbo_t *rv)
+{
+	if (rv->vbo == 0 || rv->n_ctr + rv->n_wing == 0)
+		return;
+
+	glBindBuffer(GL_ARRAY_BUFFER, rv->vbo);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(3, GL_FLOAT, 0, NULL);
+
+	glColor3f(0, 0, 1);
+	glLineWidth(3);
+	glDrawArrays(GL_LINES, 0, rv->n_ctr);
+
+	glColor3f(1, 0.25, 1);
+	glLineWidth(2);
+	glDrawArrays(GL_LINES, rv->n_ctr, rv->n_wing);
+
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void
+route_vbo_fini(route_vbo_t *rv)
+{
+	if (rv->vbo != 0)
+		glDeleteBuffers(1, &rv->vbo);
+	for (unsigned i = 0; i < rv->n_tess; i++)
+		seg_tess_free(&rv->tess[i]);
+	free(rv->tess);
+	memset(rv, 0, sizeof (*rv));
+}
@@ -0,0 +1,57 @@
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+*/
+/*
+ * Copyright 2020 Saso Kiselkov. All rights reserved.
+ */
+
+#ifndef	_ROUTE_VBO_H_
+#define	_ROUTE_VBO_H_
+
+#include <stdint.h>
+
+#include <acfutils/glew.h>
+#include <acfutils/list.h>
+
+#include "acf_outline.h"
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/*
+ * Retained-mode geometry of a list of driving segments, as drawn by the
+ * pushback planner: the route centerline and the wingtip envelope. The
+ * vertex buffer is only rebuilt when the segments or the zoom level
+ * actually change.
+ */
+typedef struct {
+	GLuint		vbo;
+	unsigned	n_ctr;		/* centerline vertices (GL_LINES) */
+	unsigned	n_wing;		/* wingtip envelope vertices (GL_LINES) */
+	uint64_t	hash;		/* hash of the geometry in `vbo' */
+	struct seg_tess	*tess;		/* per-segment vertex cache */
+	unsigned	n_tess;
+} route_vbo_t;
+
+void route_vbo_update(route_vbo_t *rv, const list_t *segs,
+    const acf_outline_t *outline, double main_z, double px_per_m);
+void route_vbo_draw(const route_vbo_t *rv);
+void route_vbo_fini(route_vbo_t *rv);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _ROUTE_VBO_H_ */
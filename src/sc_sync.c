@@ -0,0 +1,373 @@
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+*/
+/*
+ * Copyright 2020 Saso Kiselkov. All rights reserved.
+ */
+
+/*
+ * Route and tug state synchronization for shared cockpit sessions (see
+ * the smartcopilot notes in xplane.c). The master publishes its route
+ * and the tug's state through two integer array datarefs, which the
+ * syncing addon copies over to the slave:
+ *
+ * "bp/sync/route": the pushback route. The header (RT_*) holds the
+ *	route's geographic origin (the start of the first segment) and
+ *	heading. Each segment then takes up SEG_WORDS words (SEG_*), with
+ *	its start position & heading relative to the previous segment's
+ *	end, and its end relative to its own start. Positions are in the
+ *	origin's frame of reference. They're quantized first and then
+ *	subtracted, so the rounding errors don't accumulate along the
+ *	route. The slave mirrors the route into its own bp.segs, which
+ *	its start announcement and its (view-only) planner go by.
+ * "bp/sync/state": the pushback step and the tug's pose relative to the
+ *	aircraft (ST_*). Being relative, the pose keeps the slave's tug
+ *	attached to the slave's aircraft, even though the aircraft
+ *	positions themselves are only approximately synced.
+ *
+ * The first word of each array is a sequence number, which the master
+ * bumps whenever the contents change, so the datarefs don't change
+ * (and don't need to be resent) while nothing happens. A sequence number
+ * of 0 means nothing has been published yet.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <XPLMGraphics.h>
+
+#include <acfutils/assert.h>
+#include <acfutils/dr.h>
+#include <acfutils/geom.h>
+#include <acfutils/log.h>
+
+#include "sc_sync.h"
+#include "xplane.h"
+
+#define	POS_Q		0.01	/* position quantum, meters */
+#define	HDG_Q		0.01	/* heading quantum, degrees */
+#define	SPD_Q		0.001	/* speed quantum, m/s */
+#define	GEO_Q		1e-7	/* lat/lon quantum, degrees */
+#define	MAX_SYNC_SEGS	64
+
+enum {
+	RT_SEQ,
+	RT_N_SEGS,
+	RT_LAT,
+	RT_LON,
+	RT_HDG,
+	RT_HDR_WORDS
+};
+
+enum {
+	SEG_FLAGS,
+	SEG_SX,
+	SEG_SY,
+	SEG_SHDG,
+	SEG_EX,
+	SEG_EY,
+	SEG_EHDG,
+	SEG_SIZE,	/* straight segment length or turn radius */
+	SEG_WORDS
+};
+
+#define	SEG_FLAG_TURN		(1 << 0)
+#define	SEG_FLAG_BACKWARD	(1 << 1)
+#define	SEG_FLAG_RIGHT		(1 << 2)
+#define	SEG_FLAG_USER		(1 << 3)
+
+#define	ROUTE_WORDS	(RT_HDR_WORDS + MAX_SYNC_SEGS * SEG_WORDS)
+
+enum {
+	ST_SEQ,
+	ST_STEP,
+	ST_X,
+	ST_Y,
+	ST_HDG,
+	ST_SPD,
+	ST_STEER,
+	ST_WORDS
+};
+
+static struct {
+	bool_t	inited;
+	int	route[ROUTE_WORDS];
+	int	state[ST_WORDS];
+	dr_t	route_dr;
+	dr_t	state_dr;
+	int	route_seq;	/* slave: seq of the route last decoded */
+} sync;
+
+static inline int
+quant(double v, double q)
+{
+	return (round(v / q));
+}
+
+static inline int
+next_seq(int seq)
+{
+	return (seq == INT32_MAX ? 1 : seq + 1);
+}
+
+void
+sc_sync_init(void)
+{
+	ASSERT(!sync.inited);
+
+	memset(sync.route, 0, sizeof (sync.route));
+	memset(sync.state, 0, sizeof (sync.state));
+	dr_create_vi(&sync.route_dr, sync.route, ROUTE_WORDS, B_TRUE,
+	    "bp/sync/route");
+	dr_create_vi(&sync.state_dr, sync.state, ST_WORDS, B_TRUE,
+	    "bp/sync/state");
+	sync.route_seq = 0;
+	sync.inited = B_TRUE;
+}
+
+void
+sc_sync_fini(void)
+{
+	if (!sync.inited)
+		return;
+	dr_delete(&sync.route_dr);
+	dr_delete(&sync.state_dr);
+	sync.inited = B_FALSE;
+}
+
+/*
+ * Called at the end of a pushback operation. The master withdraws its
+ * route and state, the slave forgets which route it has decoded.
+ */
+void
+sc_sync_reset(void)
+{
+	ASSERT(sync.inited);
+
+	if (!slave_mode) {
+		int route_seq = sync.route[RT_SEQ];
+		int state_seq = sync.state[ST_SEQ];
+
+		memset(sync.route, 0, sizeof (sync.route));
+		memset(sync.state, 0, sizeof (sync.state));
+		if (route_seq != 0)
+			sync.route[RT_SEQ] = next_seq(route_seq);
+		if (state_seq != 0)
+			sync.state[ST_SEQ] = next_seq(state_seq);
+	}
+	sync.route_seq = 0;
+}
+
+/*
+ * Transforms `pos' into the frame of reference located at `origin' and
+ * oriented along `hdg' and quantizes it.
+ */
+static void
+pos_encode(vect2_t pos, vect2_t origin, double hdg, int *x, int *y)
+{
+	vect2_t v = vect2_rot(vect2_sub(pos, origin), -hdg);
+
+	*x = quant(v.x, POS_Q);
+	*y = quant(v.y, POS_Q);
+}
+
+static vect2_t
+pos_decode(int x, int y, vect2_t origin, double hdg)
+{
+	return (vect2_add(origin, vect2_rot(VECT2(x * POS_Q, y * POS_Q),
+	    hdg)));
+}
+
+/*
+ * Master: publishes the route in `segs'.
+ */
+void
+sc_sync_route_publish(const list_t *segs)
+{
+	const seg_t *seg = list_head((list_t *)segs);
+	int *rt = sync.route;
+	int n = 0, px = 0, py = 0, phdg = 0;
+	vect2_t origin = ZERO_VECT2;
+	double origin_hdg = 0, unused;
+	geo_pos2_t geo;
+
+	ASSERT(sync.inited);
+	ASSERT(!slave_mode);
+
+	memset(&rt[RT_N_SEGS], 0, sizeof (sync.route) - sizeof (*rt));
+	if (seg != NULL) {
+		origin = seg->start_pos;
+		origin_hdg = seg->start_hdg;
+		/* X-Plane's Z axis is flipped to ours */
+		XPLMLocalToWorld(origin.x, 0, -origin.y, &geo.lat, &geo.lon,
+		    &unused);
+		rt[RT_LAT] = quant(geo.lat, GEO_Q);
+		rt[RT_LON] = quant(geo.lon, GEO_Q);
+		rt[RT_HDG] = quant(origin_hdg, HDG_Q);
+	}
+	for (; seg != NULL; seg = list_next((list_t *)segs, seg)) {
+		int *w = &rt[RT_HDR_WORDS + n * SEG_WORDS];
+		int sx, sy, shdg, ex, ey, ehdg;
+
+		if (n == MAX_SYNC_SEGS) {
+			logMsg("Route too long to sync, only sending the first "
+			    "%d segments", MAX_SYNC_SEGS);
+			break;
+		}
+		pos_encode(seg->start_pos, origin, origin_hdg, &sx, &sy);
+		pos_encode(seg->end_pos, origin, origin_hdg, &ex, &ey);
+		shdg = quant(rel_hdg(origin_hdg, seg->start_hdg), HDG_Q);
+		ehdg = quant(rel_hdg(origin_hdg, seg->end_hdg), HDG_Q);
+
+		w[SEG_FLAGS] = (seg->backward ? SEG_FLAG_BACKWARD : 0) |
+		    (seg->user_placed ? SEG_FLAG_USER : 0);
+		if (seg->type == SEG_TYPE_TURN) {
+			w[SEG_FLAGS] |= SEG_FLAG_TURN;
+			if (seg->turn.right)
+				w[SEG_FLAGS] |= SEG_FLAG_RIGHT;
+			w[SEG_SIZE] = quant(seg->turn.r, POS_Q);
+		} else {
+			w[SEG_SIZE] = quant(seg->len, POS_Q);
+		}
+		w[SEG_SX] = sx - px;
+		w[SEG_SY] = sy - py;
+		w[SEG_SHDG] = shdg - phdg;
+		w[SEG_EX] = ex - sx;
+		w[SEG_EY] = ey - sy;
+		w[SEG_EHDG] = ehdg - shdg;
+
+		px = ex;
+		py = ey;
+		phdg = ehdg;
+		n++;
+	}
+	rt[RT_N_SEGS] = n;
+	rt[RT_SEQ] = next_seq(rt[RT_SEQ]);
+}
+
+/*
+ * Slave: if the master has published a new route since the last call,
+ * replaces the contents of `segs' with it (in our local coordinates) and
+ * returns B_TRUE. A withdrawn route leaves `segs' empty.
+ */
+bool_t
+sc_sync_route_update(list_t *segs)
+{
+	const int *rt = sync.route;
+	vect2_t origin;
+	double origin_hdg, unused;
+	int px = 0, py = 0, phdg = 0;
+	seg_t *seg;
+
+	ASSERT(sync.inited);
+	ASSERT(slave_mode);
+
+	if (rt[RT_SEQ] == sync.route_seq)
+		return (B_FALSE);
+
+	while ((seg = list_remove_head(segs)) != NULL)
+		free(seg);
+	sync.route_seq = rt[RT_SEQ];
+	if (rt[RT_N_SEGS] <= 0 || rt[RT_N_SEGS] > MAX_SYNC_SEGS)
+		return (B_TRUE);
+
+	XPLMWorldToLocal(rt[RT_LAT] * GEO_Q, rt[RT_LON] * GEO_Q, 0,
+	    &origin.x, &unused, &origin.y);
+	/* X-Plane's Z axis is flipped to ours */
+	origin.y = -origin.y;
+	origin_hdg = rt[RT_HDG] * HDG_Q;
+
+	for (int i = 0; i < rt[RT_N_SEGS]; i++) {
+		const int *w = &rt[RT_HDR_WORDS + i * SEG_WORDS];
+		int sx = px + w[SEG_SX], sy = py + w[SEG_SY];
+		int shdg = phdg + w[SEG_SHDG];
+
+		px = sx + w[SEG_EX];
+		py = sy + w[SEG_EY];
+		phdg = shdg + w[SEG_EHDG];
+
+		seg = calloc(1, sizeof (*seg));
+		seg->type = ((w[SEG_FLAGS] & SEG_FLAG_TURN) ? SEG_TYPE_TURN :
+		    SEG_TYPE_STRAIGHT);
+		seg->have_local_coords = B_TRUE;
+		seg->start_pos = pos_decode(sx, sy, origin, origin_hdg);
+		seg->start_hdg = normalize_hdg(origin_hdg + shdg * HDG_Q);
+		seg->end_pos = pos_decode(px, py, origin, origin_hdg);
+		seg->end_hdg = normalize_hdg(origin_hdg + phdg * HDG_Q);
+		seg->backward = !!(w[SEG_FLAGS] & SEG_FLAG_BACKWARD);
+		seg->user_placed = !!(w[SEG_FLAGS] & SEG_FLAG_USER);
+		if (seg->type == SEG_TYPE_TURN) {
+			seg->turn.r = w[SEG_SIZE] * POS_Q;
+			seg->turn.right = !!(w[SEG_FLAGS] & SEG_FLAG_RIGHT);
+		} else {
+			seg->len = w[SEG_SIZE] * POS_Q;
+		}
+		list_insert_tail(segs, seg);
+	}
+
+	return (B_TRUE);
+}
+
+/*
+ * Master: publishes the current pushback step and the tug's pose
+ * relative to our aircraft at `acf'.
+ */
+void
+sc_sync_state_publish(int step, const vehicle_pos_t *acf, const tug_t *tug)
+{
+	int st[ST_WORDS];
+
+	ASSERT(sync.inited);
+	ASSERT(!slave_mode);
+
+	st[ST_STEP] = step;
+	pos_encode(tug->pos.pos, acf->pos, acf->hdg, &st[ST_X], &st[ST_Y]);
+	st[ST_HDG] = quant(rel_hdg(acf->hdg, tug->pos.hdg), HDG_Q);
+	st[ST_SPD] = quant(tug->pos.spd, SPD_Q);
+	st[ST_STEER] = quant(tug->cur_steer, HDG_Q);
+
+	if (memcmp(&st[ST_STEP], &sync.state[ST_STEP],
+	    sizeof (st) - sizeof (*st)) != 0) {
+		st[ST_SEQ] = next_seq(sync.state[ST_SEQ]);
+		memcpy(sync.state, st, sizeof (st));
+	}
+}
+
+/*
+ * Slave: moves `tug' to the pose published by the master, relative to
+ * our aircraft at `acf'. We only follow the master while it's in the
+ * same pushback step as us, as otherwise the tug's pose wouldn't match
+ * what our state machine is doing with it (e.g. lifting the nosewheel).
+ * The tug's driving segments are left alone, so our state machine still
+ * progresses like before. Returns B_TRUE if the pose was applied.
+ */
+bool_t
+sc_sync_state_apply(int step, const vehicle_pos_t *acf, tug_t *tug)
+{
+	const int *st = sync.state;
+
+	ASSERT(sync.inited);
+	ASSERT(slave_mode);
+
+	if (st[ST_SEQ] == 0 || st[ST_STEP] != step)
+		return (B_FALSE);
+
+	tug->pos.pos = pos_decode(st[ST_X], st[ST_Y], acf->pos, acf->hdg);
+	tug->pos.hdg = normalize_hdg(acf->hdg + st[ST_HDG] * HDG_Q);
+	tug->pos.spd = st[ST_SPD] * SPD_Q;
+	tug->cur_steer = st[ST_STEER] * HDG_Q;
+
+	return (B_TRUE);
+}
@@ -0,0 +1,47 @@
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+*/
+/*
+ * Copyright 2020 Saso Kiselkov. All rights reserved.
+ */
+
+#ifndef	_SC_SYNC_H_
+#define	_SC_SYNC_H_
+
+#include <acfutils/list.h>
+#include <acfutils/types.h>
+
+#include "driving.h"
+#include "tug.h"
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+void sc_sync_init(void);
+void sc_sync_fini(void);
+void sc_sync_reset(void);
+
+void sc_sync_route_publish(const list_t *segs);
+void sc_sync_state_publish(int step, const vehicle_pos_t *acf,
+    const tug_t *tug);
+
+bool_t sc_sync_route_update(list_t *segs);
+bool_t sc_sync_state_apply(int step, const vehicle_pos_t *acf, tug_t *tug);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _SC_SYNC_H_ */
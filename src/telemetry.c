@@ -0,0 +1,310 @@
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+*/
+/*
+ * Copyright 2020 Saso Kiselkov. All rights reserved.
+ */
+
+/*
+ * Pushback telemetry recorder. The sim thread appends fixed-size samples
+ * into a single-producer/single-consumer ring buffer. A background thread
+ * drains the ring into Output/BetterPushback_telemetry.bin, rotating the
+ * file once it grows past MAX_FILE_SZ.
+ *
+ * The producer side only ever touches the ring and the two ring indices,
+ * so appending a sample costs a handful of stores: no locks, no syscalls
+ * and no formatting. If the writer falls behind and the ring fills up,
+ * samples are dropped. Since every telem_begin consumes a sequence number,
+ * drops show up as gaps in the `seq' field of the recorded samples.
+ *
+ * Telemetry is off unless "telemetry = true" is set in the config file.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <acfutils/assert.h>
+#include <acfutils/conf.h>
+#include <acfutils/helpers.h>
+#include <acfutils/log.h>
+#include <acfutils/thread.h>
+#include <acfutils/time.h>
+
+#include "cfg.h"
+#include "telemetry.h"
+#include "xplane.h"
+
+#define	TELEM_VERSION	1
+#define	TELEM_MAGIC	"BPTELEM"
+#define	TELEM_DIRS	bp_xpdir, "Output"
+#define	RING_SZ		4096		/* samples, must be a power of 2 */
+#define	RING_MASK	(RING_SZ - 1)
+#define	DRAIN_INTVAL	250000		/* microseconds */
+#define	MAX_FILE_SZ	(16 << 20)	/* bytes */
+#define	NUM_FILES	4		/* current file + rotated files */
+
+CTASSERT(sizeof (telem_sample_t) == 64);
+CTASSERT((RING_SZ & RING_MASK) == 0);
+
+/* File header, followed by a stream of telem_sample_t's */
+typedef struct {
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	sample_sz;
+} telem_hdr_t;
+
+static struct {
+	/* producer (sim thread) side */
+	telem_sample_t	*ring;		/* NULL when telemetry is off */
+	uint32_t	head;		/* only written by the producer */
+	uint32_t	seq;
+	double		cur_t;
+	unsigned	cur_step;
+
+	/* consumer (writer thread) side */
+	uint32_t	tail;		/* only written by the consumer */
+	FILE		*fp;
+	size_t		file_sz;
+	bool_t		write_err;
+
+	thread_t	writer;
+	mutex_t		lock;
+	condvar_t	cv;
+	bool_t		shutdown;
+} telem;
+
+static char *
+telem_path(int i)
+{
+	char filename[64];
+
+	if (i == 0) {
+		strlcpy(filename, "BetterPushback_telemetry.bin",
+		    sizeof (filename));
+	} else {
+		snprintf(filename, sizeof (filename),
+		    "BetterPushback_telemetry.%d.bin", i);
+	}
+	return (mkpathname(TELEM_DIRS, filename, NULL));
+}
+
+/*
+ * Shifts all existing telemetry files one slot up, dropping the oldest.
+ */
+static void
+telem_rotate(void)
+{
+	for (int i = NUM_FILES - 1; i > 0; i--) {
+		char *src = telem_path(i - 1);
+		char *dst = telem_path(i);
+
+		if (file_exists(src, NULL)) {
+			(void) remove_file(dst, B_TRUE);
+			(void) rename(src, dst);
+		}
+		free(src);
+		free(dst);
+	}
+}
+
+static bool_t
+telem_open(void)
+{
+	telem_hdr_t hdr = {
+	    .magic = TELEM_MAGIC,
+	    .version = TELEM_VERSION,
+	    .sample_sz = sizeof (telem_sample_t)
+	};
+	char *filename;
+
+	ASSERT3P(telem.fp, ==, NULL);
+
+	telem_rotate();
+	filename = telem_path(0);
+	telem.fp = fopen(filename, "wb");
+	free(filename);
+	if (telem.fp == NULL)
+		return (B_FALSE);
+	if (fwrite(&hdr, sizeof (hdr), 1, telem.fp) != 1) {
+		fclose(telem.fp);
+		telem.fp = NULL;
+		return (B_FALSE);
+	}
+	telem.file_sz = sizeof (hdr);
+
+	return (B_TRUE);
+}
+
+static void
+telem_write(const telem_sample_t *samples, uint32_t n)
+{
+	if (telem.write_err)
+		return;
+	if (telem.fp != NULL &&
+	    telem.file_sz + n * sizeof (*samples) > MAX_FILE_SZ) {
+		fclose(telem.fp);
+		telem.fp = NULL;
+	}
+	if (telem.fp == NULL && !telem_open()) {
+		telem.write_err = B_TRUE;
+		return;
+	}
+	if (fwrite(samples, sizeof (*samples), n, telem.fp) != n) {
+		telem.write_err = B_TRUE;
+		return;
+	}
+	telem.file_sz += n * sizeof (*samples);
+}
+
+/*
+ * Writes out everything the producer has published so far. Writer
+ * thread only.
+ */
+static void
+telem_drain(void)
+{
+	uint32_t head = __atomic_load_n(&telem.head, __ATOMIC_ACQUIRE);
+	uint32_t tail = telem.tail;
+
+	while (tail != head) {
+		uint32_t idx = tail & RING_MASK;
+		uint32_t n = MIN(head - tail, RING_SZ - idx);
+
+		telem_write(&telem.ring[idx], n);
+		tail += n;
+		/* hand the slots back to the producer */
+		__atomic_store_n(&telem.tail, tail, __ATOMIC_RELEASE);
+	}
+	if (telem.fp != NULL)
+		fflush(telem.fp);
+}
+
+static void
+telem_writer(void *unused)
+{
+	UNUSED(unused);
+
+	mutex_enter(&telem.lock);
+	while (!telem.shutdown) {
+		mutex_exit(&telem.lock);
+		telem_drain();
+		mutex_enter(&telem.lock);
+		if (!telem.shutdown) {
+			cv_timedwait(&telem.cv, &telem.lock, microclock() +
+			    DRAIN_INTVAL);
+		}
+	}
+	mutex_exit(&telem.lock);
+
+	telem_drain();
+}
+
+void
+telem_init(void)
+{
+	bool_t enabled = B_FALSE;
+
+	if (telem.ring != NULL)
+		return;
+	(void) conf_get_b(bp_conf, "telemetry", &enabled);
+	if (!enabled)
+		return;
+
+	memset(&telem, 0, sizeof (telem));
+	telem.ring = calloc(RING_SZ, sizeof (*telem.ring));
+	mutex_init(&telem.lock);
+	cv_init(&telem.cv);
+
+	if (!thread_create(&telem.writer, telem_writer, NULL)) {
+		logMsg("Error creating telemetry writer thread");
+		cv_destroy(&telem.cv);
+		mutex_destroy(&telem.lock);
+		free(telem.ring);
+		telem.ring = NULL;
+		return;
+	}
+	logMsg("Telemetry recording enabled");
+}
+
+void
+telem_fini(void)
+{
+	if (telem.ring == NULL)
+		return;
+
+	mutex_enter(&telem.lock);
+	telem.shutdown = B_TRUE;
+	cv_broadcast(&telem.cv);
+	mutex_exit(&telem.lock);
+	thread_join(&telem.writer);
+
+	if (telem.write_err)
+		logMsg("Error writing telemetry file, telemetry incomplete");
+	if (telem.fp != NULL) {
+		fclose(telem.fp);
+		telem.fp = NULL;
+	}
+	cv_destroy(&telem.cv);
+	mutex_destroy(&telem.lock);
+	free(telem.ring);
+	telem.ring = NULL;
+}
+
+/*
+ * Sets the sim time & pushback step stamped onto all subsequent samples.
+ * Called once per frame from bp_run.
+ */
+void
+telem_set_frame(double t, unsigned step)
+{
+	telem.cur_t = t;
+	telem.cur_step = step;
+}
+
+/*
+ * Reserves the next sample slot in the ring. Returns NULL if telemetry
+ * is off or the ring is full. Otherwise the caller fills in the sample
+ * and must then publish it using telem_commit. Sim thread only.
+ */
+telem_sample_t *
+telem_begin(telem_src_t src)
+{
+	telem_sample_t *s;
+
+	if (telem.ring == NULL)
+		return (NULL);
+
+	telem.seq++;
+	if (telem.head - __atomic_load_n(&telem.tail, __ATOMIC_ACQUIRE) >=
+	    RING_SZ)
+		return (NULL);
+
+	s = &telem.ring[telem.head & RING_MASK];
+	memset(s, 0, sizeof (*s));
+	s->t = telem.cur_t;
+	s->seq = telem.seq;
+	s->src = src;
+	s->step = telem.cur_step;
+
+	return (s);
+}
+
+void
+telem_commit(void)
+{
+	ASSERT(telem.ring != NULL);
+	__atomic_store_n(&telem.head, telem.head + 1, __ATOMIC_RELEASE);
+}
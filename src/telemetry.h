@@ -0,0 +1,73 @@
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+*/
+/*
+ * Copyright 2020 Saso Kiselkov. All rights reserved.
+ */
+
+#ifndef	_TELEMETRY_H_
+#define	_TELEMETRY_H_
+
+#include <stdint.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+	TELEM_SRC_BP,		/* aircraft state, from bp_run */
+	TELEM_SRC_DRIVE,	/* path follower, from drive_segs */
+	TELEM_SRC_TUG		/* tug state, from tug_run */
+} telem_src_t;
+
+/*
+ * A single fixed-size telemetry sample. Samples are written to the
+ * telemetry file verbatim (native byte order), so when changing this
+ * structure, bump TELEM_VERSION in telemetry.c.
+ */
+typedef struct {
+	double		t;		/* sim time, seconds */
+	uint32_t	seq;		/* sample sequence number */
+	uint8_t		src;		/* telem_src_t */
+	uint8_t		step;		/* pushback_step_t */
+	uint8_t		seg_type;	/* seg_type_t of the active segment */
+	uint8_t		flags;		/* TELEM_FLAG_* */
+	float		x, y;		/* local position, meters */
+	float		hdg;		/* true heading, degrees */
+	float		spd;		/* speed, m/s, negative when reversing */
+	float		steer;		/* actual steering angle, degrees */
+	float		cmd_steer;	/* commanded steering angle, degrees */
+	float		cmd_spd;	/* commanded speed, m/s */
+	float		force;		/* applied push force, Newtons */
+	float		xtrk;		/* cross-track error, meters, +right */
+	float		hdg_err;	/* heading misalignment, degrees */
+	float		wheelbase;	/* meters, tells aircraft & tug apart */
+	float		accel;		/* m/s^2 */
+} telem_sample_t;
+
+#define	TELEM_FLAG_BACKWARD	(1 << 0)	/* active segment is backward */
+#define	TELEM_FLAG_DECEL	(1 << 1)	/* decelerating for seg end */
+
+void telem_init(void);
+void telem_fini(void);
+
+void telem_set_frame(double t, unsigned step);
+telem_sample_t *telem_begin(telem_src_t src);
+void telem_commit(void);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _TELEMETRY_H_ */
@@ -0,0 +1,157 @@
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+*/
+/*
+ * Copyright 2020 Saso Kiselkov. All rights reserved.
+ */
+
+
+/*
+ * Terrain height cache for the pushback planner. Drawing the route, the
+ * aircraft symbols and the cursor lamp all need the terrain elevation at
+ * points in local OpenGL coordinates, and terrain probes aren't cheap.
+ * So we quantize those points onto a local grid of TERR_CELL_SZ cells and
+ * remember the elevation at each cell's center, probing only the first
+ * time a cell is looked at. Once a part of the route has been seen,
+ * drawing it again costs no probes at all.
+ *
+ * Cached heights are only valid for the current local coordinate system
+ * and scenery, so the cache must be flushed via terr_cache_flush whenever
+ * scenery gets reloaded. Only to be used from the main thread.
+ */
+
+#include <math.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <XPLMScenery.h>
+
+#include <acfutils/assert.h>
+#include <acfutils/avl.h>
+
+#include "terr_cache.h"
+
+#define	TERR_CELL_SZ	2	/* meters */
+#define	MAX_CELLS	(1 << 18)	/* flush everything beyond this */
+
+typedef struct {
+	int32_t		x, y;	/* cell indices */
+	double		h;	/* elevation at cell center, OpenGL Y coord */
+	avl_node_t	node;
+} terr_cell_t;
+
+static struct {
+	bool_t		inited;
+	XPLMProbeRef	probe;
+	avl_tree_t	cells;
+} tc;
+static unsigned gen = 0;
+
+static int
+terr_cell_compar(const void *a, const void *b)
+{
+	const terr_cell_t *ca = a, *cb = b;
+
+	if (ca->x < cb->x)
+		return (-1);
+	if (ca->x > cb->x)
+		return (1);
+	if (ca->y < cb->y)
+		return (-1);
+	if (ca->y > cb->y)
+		return (1);
+	return (0);
+}
+
+static void
+terr_cache_init(void)
+{
+	avl_create(&tc.cells, terr_cell_compar, sizeof (terr_cell_t),
+	    offsetof(terr_cell_t, node));
+	tc.probe = XPLMCreateProbe(xplm_ProbeY);
+	tc.inited = B_TRUE;
+}
+
+/*
+ * Returns the terrain elevation (as an OpenGL Y coordinate) at `pos',
+ * given in our local coordinates (i.e. with the OpenGL Z axis flipped).
+ */
+double
+terr_cache_height(vect2_t pos)
+{
+	terr_cell_t srch, *cell;
+	avl_index_t where;
+	XPLMProbeInfo_t info = { .structSize = sizeof (XPLMProbeInfo_t) };
+
+	if (!tc.inited)
+		terr_cache_init();
+
+	srch.x = floor(pos.x / TERR_CELL_SZ);
+	srch.y = floor(pos.y / TERR_CELL_SZ);
+	cell = avl_find(&tc.cells, &srch, &where);
+	if (cell != NULL)
+		return (cell->h);
+
+	if (avl_numnodes(&tc.cells) >= MAX_CELLS) {
+		terr_cache_flush();
+		terr_cache_init();
+		VERIFY3P(avl_find(&tc.cells, &srch, &where), ==, NULL);
+	}
+
+	/* X-Plane's Z axis is flipped to ours */
+	VERIFY3U(XPLMProbeTerrainXYZ(tc.probe,
+	    (srch.x + 0.5) * TERR_CELL_SZ, 0, -(srch.y + 0.5) * TERR_CELL_SZ,
+	    &info), ==, xplm_ProbeHitTerrain);
+
+	cell = calloc(1, sizeof (*cell));
+	cell->x = srch.x;
+	cell->y = srch.y;
+	cell->h = info.locationY;
+	avl_insert(&tc.cells, cell, where);
+
+	return (cell->h);
+}
+
+/*
+ * Drops all cached heights. Must be called whenever scenery is reloaded
+ * (which might also shift the local coordinate system) and before the
+ * plugin is disabled.
+ */
+void
+terr_cache_flush(void)
+{
+	terr_cell_t *cell;
+	void *cookie = NULL;
+
+	if (!tc.inited)
+		return;
+
+	while ((cell = avl_destroy_nodes(&tc.cells, &cookie)) != NULL)
+		free(cell);
+	avl_destroy(&tc.cells);
+	XPLMDestroyProbe(tc.probe);
+	memset(&tc, 0, sizeof (tc));
+	gen++;
+}
+
+/*
+ * Returns a number that changes with every flush of the cache. Anything
+ * built from cached heights must be rebuilt once this changes.
+ */
+unsigned
+terr_cache_gen(void)
+{
+	return (gen);
+}
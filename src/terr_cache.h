@@ -0,0 +1,37 @@
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+*/
+/*
+ * Copyright 2020 Saso Kiselkov. All rights reserved.
+ */
+
+
+#ifndef	_TERR_CACHE_H_
+#define	_TERR_CACHE_H_
+
+#include <acfutils/geom.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+double terr_cache_height(vect2_t pos);
+void terr_cache_flush(void);
+unsigned terr_cache_gen(void);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _TERR_CACHE_H_ */
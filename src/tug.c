@@ -36,6 +36,8 @@
 
 #include "cfg.h"
 #include "driving.h"
+#include "pcm_cache.h"
+#include "telemetry.h"
 #include "tug.h"
 #include "xplane.h"
 
@@ -961,20 +963,29 @@ reload_tug_handler(XPLMCommandRef cmd, XPLMCommandPhase phase, void *refcon)
 	return (1);
 }
 
-bool_t
-tug_glob_init(void)
+static bool_t
+audio_open(void)
 {
 	const char *sound_dev = NULL;
 	bool_t shared_ctx = B_FALSE;
 
-	VERIFY(!inited);
+	ASSERT3P(alc, ==, NULL);
 
 	(void) conf_get_str(bp_conf, "sound_device", &sound_dev);
 	(void) conf_get_b(bp_conf, "shared_ctx", &shared_ctx);
 	alc = openal_init(sound_dev, shared_ctx);
 	if (alc == NULL && sound_dev != NULL)
 		alc = openal_init(NULL, shared_ctx);
-	if (alc == NULL)
+
+	return (alc != NULL);
+}
+
+bool_t
+tug_glob_init(void)
+{
+	VERIFY(!inited);
+
+	if (!audio_open())
 		return (B_FALSE);
 
 	for (anim_t a = 0; a < TUG_NUM_ANIMS; a++) {
@@ -993,6 +1004,23 @@ tug_glob_init(void)
 	return (B_TRUE);
 }
 
+/*
+ * Reopens the tug sound output device after its configuration changed.
+ * Must not be called while a tug exists, as its sounds are tied to the
+ * old device.
+ */
+bool_t
+tug_glob_audio_reset(void)
+{
+	ASSERT(inited);
+
+	if (alc != NULL) {
+		openal_fini(alc);
+		alc = NULL;
+	}
+	return (audio_open());
+}
+
 void
 tug_glob_fini(void)
 {
@@ -1220,9 +1248,16 @@ tug_alloc_common(tug_info_t *ti, double tirrad)
 	tug->load_in_prog = B_TRUE;
 	XPLMLoadObjectAsync(tug->objpath, tug_load_complete, tug);
 
+	if (alc == NULL) {
+		logMsg("Error loading tug sounds: no sound output device");
+		XPLMSpeakString("Pushback failure: error loading tug sounds.");
+		goto errout;
+	}
+
 #define	LOAD_TUG_SOUND(sound) \
 	do { \
-		tug->sound = wav_load(tug->info->sound, #sound, alc); \
+		tug->sound = pcm_cache_wav_load(tug->info->sound, \
+		    #sound, alc); \
 		if (tug->sound == NULL) { \
 			logMsg("Error loading tug sound %s", \
 			    tug->info->sound); \
@@ -1421,6 +1456,7 @@ tug_run(tug_t *tug, double d_t, bool_t drive_slow)
 {
 	double steer = 0, speed = 0;
 	double accel, turn, radius;
+	telem_sample_t *s;
 
 	if (tug->load_in_prog)
 		return;
@@ -1472,6 +1508,19 @@ tug_run(tug_t *tug, double d_t, bool_t drive_slow)
 		}
 	}
 
+	if ((s = telem_begin(TELEM_SRC_TUG)) != NULL) {
+		s->x = tug->pos.pos.x;
+		s->y = tug->pos.pos.y;
+		s->hdg = tug->pos.hdg;
+		s->spd = tug->pos.spd;
+		s->steer = tug->cur_steer;
+		s->cmd_steer = steer;
+		s->cmd_spd = speed;
+		s->wheelbase = tug->veh.wheelbase;
+		s->accel = accel / d_t;
+		telem_commit();
+	}
+
 	if (!tug->TE_override) {
 		/*
 		 * In real vehicles gears are not evenly spaced, but since
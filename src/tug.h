@@ -189,6 +189,7 @@ typedef struct {
 
 bool_t tug_glob_init(void);
 void tug_glob_fini(void);
+bool_t tug_glob_audio_reset(void);
 
 bool_t tug_available(double mtow, double ng_len, double tirrad,
     unsigned gear_type, const char *arpt, const char *airline);
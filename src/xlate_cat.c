@@ -0,0 +1,510 @@
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+*/
+/*
+ * Copyright 2020 Saso Kiselkov. All rights reserved.
+ */
+
+/*
+ * Compiled translation catalogs. Rather than parsing data/po/<lang>/
+ * strings.po every time the plugin is enabled or the language changes,
+ * the .po file is compiled once into a binary hash table (much like a
+ * gettext .mo file) and stored in Output/caches/BetterPushback_xlate/
+ * <lang>.cat. As long as the .po file's mtime & size match the ones
+ * recorded in the catalog, the catalog is simply mapped into memory and
+ * used as-is, without any parsing at all.
+ *
+ * The catalog file format (all integers in native byte order) is:
+ *
+ * cat_hdr_t				file header
+ * cat_ent_t * hdr.n_buckets		open-addressing hash table
+ * char * hdr.pool_len			NUL-terminated msgid & msgstr strings
+ *
+ * The _() macro is redirected to xlate_cat_lookup by xlate_cat.h.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#if	!IBM
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <acfutils/assert.h>
+#include <acfutils/helpers.h>
+#include <acfutils/log.h>
+
+#include "xlate_cat.h"
+#include "xplane.h"
+
+#define	CAT_DIRS	bp_xpdir, "Output", "caches", "BetterPushback_xlate"
+#define	CAT_MAGIC	"BPXLATE"
+#define	CAT_VERSION	1
+#define	MIN_BUCKETS	64
+
+typedef struct {
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	n_buckets;	/* always a power of 2 */
+	uint64_t	src_mtime;	/* mtime of the .po file */
+	uint64_t	src_size;	/* size of the .po file */
+	uint32_t	n_strings;	/* number of translated strings */
+	uint32_t	pool_len;	/* bytes */
+} cat_hdr_t;
+
+typedef struct {
+	uint32_t	hash;
+	uint32_t	msgid_off;	/* UINT32_MAX marks an empty bucket */
+	uint32_t	msgstr_off;
+} cat_ent_t;
+
+typedef struct {
+	char		*buf;
+	size_t		len;
+	size_t		cap;
+} strbuf_t;
+
+static struct {
+	uint8_t		*img;		/* complete catalog image */
+	size_t		img_len;
+	bool_t		mapped;		/* `img' is mmapped, not malloc'd */
+	const cat_hdr_t	*hdr;
+	const cat_ent_t	*buckets;
+	const char	*pool;
+} cat;
+
+/* FNV-1a */
+static uint32_t
+str_hash(const char *str, size_t len)
+{
+	uint32_t h = 2166136261u;
+
+	for (size_t i = 0; i < len; i++) {
+		h ^= (uint8_t)str[i];
+		h *= 16777619u;
+	}
+	return (h);
+}
+
+static void
+sb_append(strbuf_t *sb, const char *str, size_t len)
+{
+	if (sb->len + len + 1 > sb->cap) {
+		sb->cap = MAX(sb->cap * 2, sb->len + len + 1);
+		sb->buf = realloc(sb->buf, sb->cap);
+	}
+	memcpy(&sb->buf[sb->len], str, len);
+	sb->len += len;
+	sb->buf[sb->len] = 0;
+}
+
+/*
+ * Appends the contents of the C-style quoted string at `p' to `sb',
+ * resolving escape sequences along the way.
+ */
+static void
+sb_append_quoted(strbuf_t *sb, const char *p, const char *end)
+{
+	p = memchr(p, '"', end - p);
+	if (p == NULL)
+		return;
+	for (p++; p < end && *p != '"'; p++) {
+		char c = *p;
+
+		if (c == '\\' && p + 1 < end) {
+			p++;
+			switch (*p) {
+			case 'n':
+				c = '\n';
+				break;
+			case 't':
+				c = '\t';
+				break;
+			default:
+				c = *p;
+				break;
+			}
+		}
+		sb_append(sb, &c, 1);
+	}
+}
+
+typedef struct {
+	strbuf_t	pool;
+	cat_ent_t	*ents;
+	size_t		n_ents;
+} cat_build_t;
+
+static void
+build_add(cat_build_t *b, const strbuf_t *msgid, const strbuf_t *msgstr)
+{
+	cat_ent_t *ent;
+
+	/* untranslated strings & the .po header are of no use to us */
+	if (msgid->len == 0 || msgstr->len == 0)
+		return;
+
+	b->ents = realloc(b->ents, (b->n_ents + 1) * sizeof (*b->ents));
+	ent = &b->ents[b->n_ents++];
+	ent->hash = str_hash(msgid->buf, msgid->len);
+	ent->msgid_off = b->pool.len;
+	sb_append(&b->pool, msgid->buf, msgid->len + 1);
+	ent->msgstr_off = b->pool.len;
+	sb_append(&b->pool, msgstr->buf, msgstr->len + 1);
+}
+
+/*
+ * Parses the msgid/msgstr pairs out of the .po file contents in `buf'.
+ * Message contexts and plural forms aren't used by us, so they are
+ * skipped.
+ */
+static void
+po_parse(cat_build_t *b, const char *buf, size_t len)
+{
+	enum { FIELD_NONE, FIELD_MSGID, FIELD_MSGSTR } field = FIELD_NONE;
+	strbuf_t msgid = { NULL, 0, 0 }, msgstr = { NULL, 0, 0 };
+	const char *end = buf + len;
+
+	sb_append(&msgid, "", 0);
+	sb_append(&msgstr, "", 0);
+
+	for (const char *line = buf; line < end;) {
+		const char *eol = memchr(line, '\n', end - line);
+		const char *p = line;
+
+		if (eol == NULL)
+			eol = end;
+		while (p < eol && (*p == ' ' || *p == '\t' || *p == '\r'))
+			p++;
+
+		if (p == eol || *p == '#') {
+			/* blank lines & comments carry no strings */
+		} else if (strncmp(p, "msgid ", 6) == 0) {
+			build_add(b, &msgid, &msgstr);
+			msgid.len = msgstr.len = 0;
+			sb_append_quoted(&msgid, p + 5, eol);
+			field = FIELD_MSGID;
+		} else if (strncmp(p, "msgstr ", 7) == 0) {
+			sb_append_quoted(&msgstr, p + 6, eol);
+			field = FIELD_MSGSTR;
+		} else if (*p == '"') {
+			if (field == FIELD_MSGID)
+				sb_append_quoted(&msgid, p, eol);
+			else if (field == FIELD_MSGSTR)
+				sb_append_quoted(&msgstr, p, eol);
+		} else {
+			/* msgctxt, msgid_plural, msgstr[N] */
+			field = FIELD_NONE;
+		}
+
+		line = eol + 1;
+	}
+	build_add(b, &msgid, &msgstr);
+
+	free(msgid.buf);
+	free(msgstr.buf);
+}
+
+/*
+ * Compiles the .po file `po_file' into a catalog image. Returns NULL if
+ * the .po file can't be read.
+ */
+static uint8_t *
+cat_compile(const char *po_file, const struct stat *st, size_t *img_len)
+{
+	FILE *fp = fopen(po_file, "rb");
+	char *buf;
+	cat_build_t b = { { NULL, 0, 0 }, NULL, 0 };
+	size_t n_buckets = MIN_BUCKETS;
+	cat_hdr_t hdr;
+	cat_ent_t *buckets;
+	uint8_t *img;
+
+	if (fp == NULL) {
+		logMsg("Error reading %s: %s", po_file, strerror(errno));
+		return (NULL);
+	}
+	buf = malloc(st->st_size + 1);
+	if (fread(buf, 1, st->st_size, fp) != (size_t)st->st_size) {
+		logMsg("Error reading %s: %s", po_file, strerror(errno));
+		free(buf);
+		fclose(fp);
+		return (NULL);
+	}
+	fclose(fp);
+
+	po_parse(&b, buf, st->st_size);
+	free(buf);
+
+	while (n_buckets < 2 * b.n_ents)
+		n_buckets *= 2;
+
+	memset(&hdr, 0, sizeof (hdr));
+	memcpy(hdr.magic, CAT_MAGIC, sizeof (hdr.magic));
+	hdr.version = CAT_VERSION;
+	hdr.n_buckets = n_buckets;
+	hdr.src_mtime = st->st_mtime;
+	hdr.src_size = st->st_size;
+	hdr.n_strings = b.n_ents;
+	hdr.pool_len = b.pool.len;
+
+	*img_len = sizeof (hdr) + n_buckets * sizeof (*buckets) + b.pool.len;
+	img = malloc(*img_len);
+	memcpy(img, &hdr, sizeof (hdr));
+	buckets = (cat_ent_t *)(img + sizeof (hdr));
+	for (size_t i = 0; i < n_buckets; i++)
+		buckets[i].msgid_off = UINT32_MAX;
+	for (size_t i = 0; i < b.n_ents; i++) {
+		size_t j;
+
+		for (j = b.ents[i].hash & (n_buckets - 1);
+		    buckets[j].msgid_off != UINT32_MAX;
+		    j = (j + 1) & (n_buckets - 1))
+			;
+		buckets[j] = b.ents[i];
+	}
+	if (b.pool.len != 0) {
+		memcpy(img + sizeof (hdr) + n_buckets * sizeof (*buckets),
+		    b.pool.buf, b.pool.len);
+	}
+
+	free(b.pool.buf);
+	free(b.ents);
+
+	return (img);
+}
+
+/*
+ * Checks that the catalog image in `img' is intact and was compiled from
+ * the .po file described by `st'.
+ */
+static bool_t
+cat_validate(const uint8_t *img, size_t len, const struct stat *st)
+{
+	const cat_hdr_t *hdr = (const cat_hdr_t *)img;
+	const cat_ent_t *buckets;
+	const char *pool;
+	size_t n_used = 0;
+
+	if (len < sizeof (*hdr) ||
+	    memcmp(hdr->magic, CAT_MAGIC, sizeof (hdr->magic)) != 0 ||
+	    hdr->version != CAT_VERSION ||
+	    hdr->src_mtime != (uint64_t)st->st_mtime ||
+	    hdr->src_size != (uint64_t)st->st_size ||
+	    hdr->n_buckets == 0 ||
+	    (hdr->n_buckets & (hdr->n_buckets - 1)) != 0 ||
+	    len != sizeof (*hdr) + (size_t)hdr->n_buckets *
+	    sizeof (*buckets) + hdr->pool_len)
+		return (B_FALSE);
+
+	buckets = (const cat_ent_t *)(img + sizeof (*hdr));
+	pool = (const char *)&buckets[hdr->n_buckets];
+	if (hdr->pool_len != 0 && pool[hdr->pool_len - 1] != 0)
+		return (B_FALSE);
+	for (size_t i = 0; i < hdr->n_buckets; i++) {
+		if (buckets[i].msgid_off == UINT32_MAX)
+			continue;
+		if (buckets[i].msgid_off >= hdr->pool_len ||
+		    buckets[i].msgstr_off >= hdr->pool_len)
+			return (B_FALSE);
+		n_used++;
+	}
+	/* lookups rely on there being at least one empty bucket */
+	return (n_used < hdr->n_buckets);
+}
+
+static char *
+cat_path(const char *lang)
+{
+	char filename[64];
+
+	snprintf(filename, sizeof (filename), "%s.cat", lang);
+	return (mkpathname(CAT_DIRS, filename, NULL));
+}
+
+/*
+ * Maps the cached catalog `filename' into memory. Returns B_FALSE if
+ * there is no cached catalog, or if it's stale.
+ */
+static bool_t
+cat_cache_load(const char *filename, const struct stat *st)
+{
+#if	IBM
+	FILE *fp = fopen(filename, "rb");
+	uint8_t *img = NULL;
+	long len;
+
+	if (fp == NULL)
+		return (B_FALSE);
+	if (fseek(fp, 0, SEEK_END) < 0 || (len = ftell(fp)) < 0 ||
+	    fseek(fp, 0, SEEK_SET) < 0)
+		goto errout;
+	img = malloc(MAX(len, 1));
+	if (fread(img, 1, len, fp) != (size_t)len ||
+	    !cat_validate(img, len, st))
+		goto errout;
+	fclose(fp);
+	cat.mapped = B_FALSE;
+#else	/* !IBM */
+	int fd = open(filename, O_RDONLY);
+	struct stat cst;
+	void *img = MAP_FAILED;
+	size_t len = 0;
+
+	if (fd < 0)
+		return (B_FALSE);
+	if (fstat(fd, &cst) < 0 || cst.st_size == 0)
+		goto errout;
+	len = cst.st_size;
+	img = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (img == MAP_FAILED || !cat_validate(img, len, st))
+		goto errout;
+	close(fd);
+	cat.mapped = B_TRUE;
+#endif	/* !IBM */
+
+	cat.img = img;
+	cat.img_len = len;
+
+	return (B_TRUE);
+errout:
+#if	IBM
+	free(img);
+	fclose(fp);
+#else	/* !IBM */
+	if (img != MAP_FAILED)
+		munmap(img, len);
+	close(fd);
+#endif	/* !IBM */
+	return (B_FALSE);
+}
+
+static void
+cat_cache_store(const char *filename, const uint8_t *img, size_t len)
+{
+	char *dirname = mkpathname(CAT_DIRS, NULL);
+	char *tmpname = sprintf_alloc("%s.tmp", filename);
+	FILE *fp = NULL;
+
+	if (!file_exists(dirname, NULL) &&
+	    !create_directory_recursive(dirname))
+		goto out;
+	fp = fopen(tmpname, "wb");
+	if (fp == NULL) {
+		logMsg("Error writing file %s: %s", tmpname, strerror(errno));
+		goto out;
+	}
+	if (fwrite(img, 1, len, fp) != len) {
+		logMsg("Error writing file %s: %s", tmpname, strerror(errno));
+		fclose(fp);
+		fp = NULL;
+		remove_file(tmpname, B_TRUE);
+		goto out;
+	}
+	fclose(fp);
+	fp = NULL;
+	/* rename won't replace an existing file on Windows */
+	remove_file(filename, B_FALSE);
+	if (rename(tmpname, filename) != 0) {
+		logMsg("Error renaming %s to %s: %s", tmpname, filename,
+		    strerror(errno));
+		remove_file(tmpname, B_TRUE);
+	}
+
+out:
+	free(dirname);
+	free(tmpname);
+}
+
+/*
+ * Loads the translations for language `lang' from the .po file `po_file',
+ * replacing any previously loaded ones. If the .po file doesn't exist,
+ * strings are left untranslated and B_FALSE is returned.
+ */
+bool_t
+xlate_cat_load(const char *lang, const char *po_file)
+{
+	char *filename;
+	struct stat st;
+
+	xlate_cat_unload();
+
+	if (stat(po_file, &st) < 0)
+		return (B_FALSE);
+
+	filename = cat_path(lang);
+	if (!cat_cache_load(filename, &st)) {
+		cat.img = cat_compile(po_file, &st, &cat.img_len);
+		if (cat.img == NULL) {
+			free(filename);
+			return (B_FALSE);
+		}
+		cat.mapped = B_FALSE;
+		cat_cache_store(filename, cat.img, cat.img_len);
+	}
+	free(filename);
+
+	cat.hdr = (const cat_hdr_t *)cat.img;
+	cat.buckets = (const cat_ent_t *)(cat.img + sizeof (*cat.hdr));
+	cat.pool = (const char *)&cat.buckets[cat.hdr->n_buckets];
+
+	return (B_TRUE);
+}
+
+void
+xlate_cat_unload(void)
+{
+	if (cat.img == NULL)
+		return;
+#if	!IBM
+	if (cat.mapped)
+		munmap(cat.img, cat.img_len);
+	else
+#endif
+		free(cat.img);
+	memset(&cat, 0, sizeof (cat));
+}
+
+/*
+ * Returns the translation of `msgid', or `msgid' itself if there is
+ * none.
+ */
+const char *
+xlate_cat_lookup(const char *msgid)
+{
+	size_t len, mask;
+	uint32_t hash;
+
+	if (cat.hdr == NULL || msgid == NULL)
+		return (msgid);
+
+	len = strlen(msgid);
+	hash = str_hash(msgid, len);
+	mask = cat.hdr->n_buckets - 1;
+	for (size_t i = hash & mask;; i = (i + 1) & mask) {
+		const cat_ent_t *ent = &cat.buckets[i];
+
+		if (ent->msgid_off == UINT32_MAX)
+			return (msgid);
+		if (ent->hash == hash &&
+		    strcmp(&cat.pool[ent->msgid_off], msgid) == 0)
+			return (&cat.pool[ent->msgstr_off]);
+	}
+}
@@ -0,0 +1,41 @@
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+*/
+/*
+ * Copyright 2020 Saso Kiselkov. All rights reserved.
+ */
+
+#ifndef	_XLATE_CAT_H_
+#define	_XLATE_CAT_H_
+
+#include <acfutils/intl.h>
+#include <acfutils/types.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+bool_t xlate_cat_load(const char *lang, const char *po_file);
+void xlate_cat_unload(void);
+const char *xlate_cat_lookup(const char *msgid);
+
+/* Route all of our translated strings through the compiled catalog */
+#undef	_
+#define	_(str)	xlate_cat_lookup(str)
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _XLATE_CAT_H_ */
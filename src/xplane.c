@@ -17,6 +17,7 @@
  */
 
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
@@ -31,18 +32,25 @@
 #include <acfutils/crc64.h>
 #include <acfutils/glew.h>
 #include <acfutils/helpers.h>
-#include <acfutils/intl.h>
 #include <acfutils/log.h>
 #include <acfutils/wav.h>
 #include <acfutils/time.h>
 
+#include "arpt_overlay.h"
+#include "arpt_svc.h"
+#include "async_log.h"
 #include "bp.h"
 #include "bp_cam.h"
 #include "cab_view.h"
 #include "cfg.h"
 #include "ff_a320_intf.h"
 #include "msg.h"
+#include "pcm_cache.h"
+#include "sc_sync.h"
+#include "telemetry.h"
+#include "terr_cache.h"
 #include "tug.h"
+#include "xlate_cat.h"
 #include "xplane.h"
 #include "wed2route.h"
 
@@ -95,16 +103,16 @@ airportdb_t		*airportdb = NULL;
 
 static bool_t bp_priv_enable(void);
 static void bp_priv_disable(void);
-static float bp_do_reload(float, float, int, void *);
+static float bp_do_conf_apply(float, float, int, void *);
 
-static bool_t			reload_rqst = B_FALSE;
-static XPLMCreateFlightLoop_t	reload_floop = {
-    .structSize = sizeof (reload_floop),
+static bool_t			conf_apply_rqst = B_FALSE;
+static XPLMCreateFlightLoop_t	conf_apply_floop = {
+    .structSize = sizeof (conf_apply_floop),
     .phase = xplm_FlightLoop_Phase_AfterFlightModel,
-    .callbackFunc = bp_do_reload,
+    .callbackFunc = bp_do_conf_apply,
     .refcon = NULL
 };
-static XPLMFlightLoopID		reload_floop_ID = NULL;
+static XPLMFlightLoopID		conf_apply_floop_ID = NULL;
 
 /*
  * These datarefs are for syncing two instances of BetterPushback over the
@@ -127,7 +135,7 @@ static XPLMFlightLoopID		reload_floop_ID = NULL;
  *	slave. This is a signal from the master machine to the slave that
  *	if late_plan_requested was in effect, the slave can continue with
  *	the state transitions past the late_plan_requested limit. This is
- *	needed because we don't transfer the route to the slave, so the
+ *	needed because the route itself (see 7) needn't be synced, so the
  *	slave cannot use the presence of a route as a condition to continue.
  * 5) The string dataref "bp/tug_name" must be synced from master to slave.
  *	This string identifies which tug model the master selected (since tug
@@ -135,9 +143,15 @@ static XPLMFlightLoopID		reload_floop_ID = NULL;
  *	object using tug_alloc_man. Both master and slave must have identical
  *	tug libraries, otherwise sync fails.
  * 6) The command "BetterPushback/start" should be synced from mater to slave.
- *	There's no need to sync any other commands. The planning GUI is
- *	disabled on the slave machine and stopping of the pushback can only be
- *	performed by the master machine.
+ *	There's no need to sync any other commands. On the slave machine, the
+ *	planning GUI only shows the master's route and stopping of the
+ *	pushback can only be performed by the master machine.
+ * 7) The integer array datarefs "bp/sync/route" and "bp/sync/state" should
+ *	be synced from master to slave. They carry the master's route and
+ *	its tug's pose (see sc_sync.c), which lets the slave show the route
+ *	in its planner and its tug follow the master's exactly. They only
+ *	change when the master's state does. Without them, the slave's tug
+ *	simply tracks the slave's nosewheel.
  */
 static dr_t	bp_started_dr, bp_connected_dr, slave_mode_dr, op_complete_dr;
 static dr_t	plan_complete_dr, bp_tug_name_dr;
@@ -296,7 +310,7 @@ start_cam_handler(XPLMCommandRef cmd, XPLMCommandPhase phase, void *refcon)
 {
 	UNUSED(cmd);
 	UNUSED(refcon);
-	if (slave_mode || late_plan_requested)
+	if (late_plan_requested)
 		return (1);
 	if (phase != xplm_CommandEnd || !bp_init() || !bp_cam_start()) {
 		start_after_cam = B_FALSE;
@@ -315,13 +329,14 @@ stop_cam_handler(XPLMCommandRef cmd, XPLMCommandPhase phase, void *refcon)
 {
 	UNUSED(cmd);
 	UNUSED(refcon);
-	if (slave_mode)
-		return (1);
 	if (phase != xplm_CommandEnd || !bp_init() || !bp_cam_stop())
 		return (1);
 
 	XPLMEnableMenuItem(root_menu, start_pb_plan_menu_item, B_TRUE);
 	XPLMEnableMenuItem(root_menu, stop_pb_plan_menu_item, B_FALSE);
+	/* the slave's planner was only showing the master's route */
+	if (slave_mode)
+		return (1);
 	XPLMEnableMenuItem(root_menu, start_pb_menu_item, B_TRUE);
 	XPLMEnableMenuItem(root_menu, stop_pb_menu_item, B_FALSE);
 	if (late_plan_requested) {
@@ -455,11 +470,13 @@ slave_mode_cb(dr_t *dr, void *unused)
 	UNUSED(dr);
 	VERIFY(!bp_started);
 
+	/* the planner is view-only on the slave, so restart it afresh */
+	(void) bp_cam_stop();
 	if (slave_mode) {
 		bp_fini();
 		XPLMEnableMenuItem(root_menu, start_pb_menu_item, B_FALSE);
 		XPLMEnableMenuItem(root_menu, stop_pb_menu_item, B_FALSE);
-		XPLMEnableMenuItem(root_menu, start_pb_plan_menu_item, B_FALSE);
+		XPLMEnableMenuItem(root_menu, start_pb_plan_menu_item, B_TRUE);
 		XPLMEnableMenuItem(root_menu, stop_pb_plan_menu_item, B_FALSE);
 	} else {
 		XPLMEnableMenuItem(root_menu, start_pb_menu_item, B_TRUE);
@@ -491,13 +508,14 @@ status_check(float elapsed, float elapsed2, int counter, void *refcon)
 		}
 		/*
 		 * If we were in master mode, stop the camera, flush out all
-		 * pushback segments and inhibit all menu items. The master
-		 * will control us.
+		 * pushback segments and inhibit all menu items, except for
+		 * the (view-only) planner. The master will control us.
 		 */
+		(void) bp_cam_stop();
 		bp_fini();
 		XPLMEnableMenuItem(root_menu, start_pb_menu_item, B_FALSE);
 		XPLMEnableMenuItem(root_menu, stop_pb_menu_item, B_FALSE);
-		XPLMEnableMenuItem(root_menu, start_pb_plan_menu_item, B_FALSE);
+		XPLMEnableMenuItem(root_menu, start_pb_plan_menu_item, B_TRUE);
 		XPLMEnableMenuItem(root_menu, stop_pb_plan_menu_item, B_FALSE);
 		slave_mode = B_TRUE;
 	} else if (dr_geti(&smartcopilot_state) != SMARTCOPILOT_STATE_SLAVE &&
@@ -508,6 +526,7 @@ status_check(float elapsed, float elapsed2, int counter, void *refcon)
 			    "connection lost. Stopping operation."));
 		}
 		/* If we were in slave mode, reenable the menu items. */
+		(void) bp_cam_stop();
 		bp_fini();
 		XPLMEnableMenuItem(root_menu, start_pb_menu_item, B_TRUE);
 		XPLMEnableMenuItem(root_menu, stop_pb_menu_item, B_FALSE);
@@ -522,9 +541,11 @@ status_check(float elapsed, float elapsed2, int counter, void *refcon)
 static void
 xlate_init(void)
 {
+	const char *lang = bp_get_lang();
 	char *po_file = mkpathname(xpdir, plugindir, "data", "po",
-	    bp_get_lang(), "strings.po", NULL);
-	(void) acfutils_xlate_init(po_file);
+	    lang, "strings.po", NULL);
+
+	(void) xlate_cat_load(lang, po_file);
 	free(po_file);
 }
 
@@ -534,7 +555,8 @@ XPluginStart(char *name, char *sig, char *desc)
 	char *p;
 	GLenum err;
 
-	log_init(XPLMDebugString, "BetterPushback");
+	async_log_init();
+	log_init(async_log_write, "BetterPushback");
 	logMsg("This is BetterPushback-" BP_PLUGIN_VERSION
 	    " libacfutils-%s", libacfutils_version);
 
@@ -546,6 +568,7 @@ XPluginStart(char *name, char *sig, char *desc)
 		/* Problem: glewInit failed, something is seriously wrong. */
 		logMsg("FATAL ERROR: cannot initialize libGLEW: %s",
 		    glewGetErrorString(err));
+		async_log_fini();
 		return (0);
 	}
 
@@ -585,8 +608,10 @@ XPluginStart(char *name, char *sig, char *desc)
 	strcpy(desc, BP_PLUGIN_DESCRIPTION);
 
 	/* We need the configuration very early to be able to pick the lang */
-	if (!bp_conf_init())
+	if (!bp_conf_init()) {
+		async_log_fini();
 		return (0);
+	}
 
 	/* We need the i18n support really early, so init early */
 	xlate_init();
@@ -623,10 +648,11 @@ XPluginStart(char *name, char *sig, char *desc)
 	    "bp/plan_complete");
 	dr_create_b(&bp_tug_name_dr, bp_tug_name, sizeof (bp_tug_name),
 	    B_TRUE, "bp/tug_name");
+	sc_sync_init();
 
 	XPLMGetVersions(&bp_xp_ver, &bp_xplm_ver, &bp_host_id);
 
-	reload_floop_ID = XPLMCreateFlightLoop(&reload_floop);
+	conf_apply_floop_ID = XPLMCreateFlightLoop(&conf_apply_floop);
 
 	return (1);
 }
@@ -635,18 +661,22 @@ PLUGIN_API void
 XPluginStop(void)
 {
 	bp_conf_fini();
-	acfutils_xlate_fini();
+	xlate_cat_unload();
 	tug_glob_fini();
+	arpt_svc_stop();
 	bp_shut_fini();
 	dr_delete(&bp_started_dr);
 	dr_delete(&slave_mode_dr);
 	dr_delete(&op_complete_dr);
 	dr_delete(&bp_tug_name_dr);
+	sc_sync_fini();
 
-	if (reload_floop_ID != NULL) {
-		XPLMDestroyFlightLoop(reload_floop_ID);
-		reload_floop_ID = NULL;
+	if (conf_apply_floop_ID != NULL) {
+		XPLMDestroyFlightLoop(conf_apply_floop_ID);
+		conf_apply_floop_ID = NULL;
 	}
+
+	async_log_fini();
 }
 
 /*
@@ -672,16 +702,28 @@ PLUGIN_API void
 XPluginReceiveMessage(XPLMPluginID from, int msg, void *param)
 {
 	UNUSED(from);
-	UNUSED(param);
 
 	switch (msg) {
+	case XPLM_MSG_SCENERY_LOADED:
+		/* cached terrain heights are stale in the new scenery */
+		terr_cache_flush();
+		break;
 	case XPLM_MSG_AIRPORT_LOADED:
+		terr_cache_flush();
+		/*FALLTHROUGH*/
 	case XPLM_MSG_PLANE_LOADED:
 		/* Force a reinit to re-read aircraft size params */
 		smartcopilot_present = dr_find(&smartcopilot_state,
 		    "scp/api/ismaster");
 		stop_cam_handler(NULL, xplm_CommandEnd, NULL);
-		bp_fini();
+		/*
+		 * Session-independent resources can be kept across an
+		 * airport change, but not if the user's aircraft changed.
+		 */
+		if (msg == XPLM_MSG_PLANE_LOADED && (intptr_t)param == 0)
+			bp_warm_flush();
+		else
+			bp_fini();
 		cab_view_fini();
 #ifndef	SLAVE_DEBUG
 		bp_tug_name[0] = '\0';
@@ -696,6 +738,32 @@ XPluginReceiveMessage(XPLMPluginID from, int msg, void *param)
 		ff_a320_intf_fini();
 }
 
+/*
+ * (Re)sets the names of our menu items in the current language. Doing
+ * this in place, rather than recreating the menus, leaves the items'
+ * enabled state alone.
+ */
+static void
+menus_xlate(void)
+{
+	XPLMSetMenuItemName(root_menu, start_pb_plan_menu_item,
+	    _("Pre-plan pushback"), 0);
+	XPLMSetMenuItemName(root_menu, stop_pb_plan_menu_item,
+	    _("Close pushback planner"), 0);
+	XPLMSetMenuItemName(root_menu, start_pb_menu_item,
+	    _("Start pushback"), 0);
+	XPLMSetMenuItemName(root_menu, stop_pb_menu_item,
+	    _("Stop pushback"), 0);
+	XPLMSetMenuItemName(root_menu, cab_cam_menu_item,
+	    _("Tug cab view"), 0);
+	XPLMSetMenuItemName(root_menu, prefs_menu_item,
+	    _("Preferences..."), 0);
+	XPLMSetMenuItemName(root_menu, dev_menu_item,
+	    _("Developer menu"), 0);
+	XPLMSetMenuItemName(dev_menu, recreate_routes_menu_item,
+	    _("Recreate routes from WED"), 0);
+}
+
 static bool_t
 bp_priv_enable(void)
 {
@@ -709,7 +777,6 @@ bp_priv_enable(void)
 	 * Reinit translations & config to allow switching languages on
 	 * the fly.
 	 */
-	acfutils_xlate_fini();
 	xlate_init();
 	bp_conf_fini();
 	if (!bp_conf_init())
@@ -720,8 +787,12 @@ bp_priv_enable(void)
 	airportdb = calloc(1, sizeof (*airportdb));
 	airportdb_create(airportdb, bp_xpdir, cachedir);
 
-	if (!recreate_cache(airportdb) || !tug_glob_init())
+	/* the airport service builds the database cache in the background */
+	if (!tug_glob_init() || !arpt_svc_init(airportdb))
 		goto errout;
+	telem_init();
+	msg_index_init();
+	pcm_cache_trim();
 
 	XPLMRegisterCommandHandler(start_pb, start_pb_handler, 1, NULL);
 	XPLMRegisterCommandHandler(stop_pb, stop_pb_handler, 1, NULL);
@@ -737,24 +808,22 @@ bp_priv_enable(void)
 	root_menu = XPLMCreateMenu("Better Pushback", XPLMFindPluginsMenu(),
 	    plugins_menu_item, menu_cb, NULL);
 
-	start_pb_plan_menu_item = XPLMAppendMenuItem(root_menu,
-	    _("Pre-plan pushback"), start_cam, 1);
-	stop_pb_plan_menu_item = XPLMAppendMenuItem(root_menu,
-	    _("Close pushback planner"), stop_cam, 1);
-	start_pb_menu_item = XPLMAppendMenuItem(root_menu,
-	    _("Start pushback"), start_pb, 1);
-	stop_pb_menu_item = XPLMAppendMenuItem(root_menu,
-	    _("Stop pushback"), stop_pb, 1);
-	cab_cam_menu_item = XPLMAppendMenuItem(root_menu,
-	    _("Tug cab view"), cab_cam, 1);
-	prefs_menu_item = XPLMAppendMenuItem(root_menu,
-	    _("Preferences..."), &prefs_menu_item, 1);
-	dev_menu_item = XPLMAppendMenuItem(root_menu,
-	    _("Developer menu"), NULL, 1);
+	/* item names are filled in by menus_xlate */
+	start_pb_plan_menu_item = XPLMAppendMenuItem(root_menu, "",
+	    start_cam, 1);
+	stop_pb_plan_menu_item = XPLMAppendMenuItem(root_menu, "",
+	    stop_cam, 1);
+	start_pb_menu_item = XPLMAppendMenuItem(root_menu, "", start_pb, 1);
+	stop_pb_menu_item = XPLMAppendMenuItem(root_menu, "", stop_pb, 1);
+	cab_cam_menu_item = XPLMAppendMenuItem(root_menu, "", cab_cam, 1);
+	prefs_menu_item = XPLMAppendMenuItem(root_menu, "",
+	    &prefs_menu_item, 1);
+	dev_menu_item = XPLMAppendMenuItem(root_menu, "", NULL, 1);
 	dev_menu = XPLMCreateMenu(_("Developer menu"), root_menu,
 	    dev_menu_item, menu_cb, NULL);
-	recreate_routes_menu_item = XPLMAppendMenuItem(dev_menu,
-	    _("Recreate routes from WED"), recreate_routes, 1);
+	recreate_routes_menu_item = XPLMAppendMenuItem(dev_menu, "",
+	    recreate_routes, 1);
+	menus_xlate();
 
 	XPLMEnableMenuItem(root_menu, start_pb_menu_item, B_TRUE);
 	XPLMEnableMenuItem(root_menu, stop_pb_menu_item, B_FALSE);
@@ -778,6 +847,7 @@ bp_priv_enable(void)
 errout:
 	if (cachedir != NULL)
 		free(cachedir);
+	arpt_svc_fini();
 	if (airportdb != NULL) {
 		airportdb_destroy(airportdb);
 		free(airportdb);
@@ -805,10 +875,16 @@ bp_priv_disable(void)
 	XPLMUnregisterCommandHandler(recreate_routes, recreate_routes_handler,
 	    1, NULL);
 
-	bp_fini();
+	bp_warm_flush();
+	msg_index_fini();
+	unload_buttons();
+	arpt_overlay_fini();
+	terr_cache_flush();
 	tug_glob_fini();
 	cab_view_fini();
 
+	telem_fini();
+	arpt_svc_fini();
 	airportdb_destroy(airportdb);
 	free(airportdb);
 	airportdb = NULL;
@@ -820,27 +896,61 @@ bp_priv_disable(void)
 	inited = B_FALSE;
 }
 
+/*
+ * Puts the configuration changes in `chg' (a conf_chg_t mask) into
+ * effect. Must only be called while no pushback is in progress, so that
+ * no tug or voice message is using the sound devices being reopened.
+ * Voice messages and button icons are keyed by language, so bp_init
+ * reloads them on its next call if the language has changed.
+ */
+static void
+conf_apply(unsigned chg)
+{
+	ASSERT(!bp_started);
+
+	if (!inited)
+		return;
+	if (chg & CONF_CHG_LANG) {
+		xlate_init();
+		menus_xlate();
+		bp_conf_gui_reset();
+	}
+	if (chg & CONF_CHG_RADIO_DEV)
+		bp_msgs_flush();
+	if ((chg & CONF_CHG_SOUND_DEV) && !tug_glob_audio_reset())
+		logMsg("Error reopening the tug sound output device");
+	if ((chg & CONF_CHG_XP11_TUG) && bp_xp_ver >= 11000) {
+		bool_t dont_hide_xp_tug = B_FALSE;
+
+		(void) conf_get_b(bp_conf, "dont_hide_xp11_tug",
+		    &dont_hide_xp_tug);
+		set_xp11_tug_hidden(!dont_hide_xp_tug);
+	}
+}
+
 static float
-bp_do_reload(float u1, float u2, int u3, void *u4)
+bp_do_conf_apply(float u1, float u2, int u3, void *u4)
 {
 	UNUSED(u1);
 	UNUSED(u2);
 	UNUSED(u3);
 	UNUSED(u4);
-	if (reload_rqst) {
-		bp_priv_disable();
-		VERIFY(bp_priv_enable());
-		reload_rqst = B_FALSE;
+	if (conf_apply_rqst) {
+		/* a pushback started in the meantime, try again later */
+		if (bp_started)
+			return (1);
+		conf_apply(bp_conf_changes());
+		conf_apply_rqst = B_FALSE;
 	}
 	return (0);
 }
 
 void
-bp_sched_reload(void)
+bp_sched_conf_apply(void)
 {
-	reload_rqst = B_TRUE;
-	ASSERT(reload_floop_ID != NULL);
-	XPLMScheduleFlightLoop(reload_floop_ID, -1, 1);
+	conf_apply_rqst = B_TRUE;
+	ASSERT(conf_apply_floop_ID != NULL);
+	XPLMScheduleFlightLoop(conf_apply_floop_ID, -1, 1);
 }
 
 #if	IBM
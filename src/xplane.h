@@ -59,7 +59,7 @@ PLUGIN_API void XPluginReceiveMessage(XPLMPluginID from, int msg, void *param);
 void bp_reconnect_notify(void);
 void bp_done_notify(void);
 const char *bp_get_lang(void);
-void bp_sched_reload(void);
+void bp_sched_conf_apply(void);
 
 #ifdef __cplusplus
 }